@@ -0,0 +1,87 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "button_grid.hpp"
+
+#include <algorithm>
+
+
+Button_grid::Button_grid(int cell_size) : m_cell_size(cell_size > 0 ? cell_size : 64) {}
+
+
+int Button_grid::cell_of(int coord) const
+{
+    // Division arrondie vers le bas, y compris pour les coordonnées négatives
+    return coord >= 0 ? coord / m_cell_size : -((-coord + m_cell_size - 1) / m_cell_size);
+}
+
+uint64_t Button_grid::cell_key(int cell_x, int cell_y)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cell_x)) << 32) | static_cast<uint32_t>(cell_y);
+}
+
+bool Button_grid::is_oversized(int x, int y, int w, int h) const
+{
+    long cells_x = cell_of(x + std::max(w, 0)) - cell_of(x) + 1;
+    long cells_y = cell_of(y + std::max(h, 0)) - cell_of(y) + 1;
+    return cells_x * cells_y > m_max_cells_per_button;
+}
+
+
+void Button_grid::insert(uint64_t key, int x, int y, int w, int h)
+{
+    if (is_oversized(x, y, w, h))
+    {
+        m_oversized.push_back(key);
+        return;
+    }
+
+    // Le bouton est ajouté à toutes les cases qu'il recouvre
+    for (int cell_x = cell_of(x); cell_x <= cell_of(x + std::max(w, 0)); cell_x++)
+        for (int cell_y = cell_of(y); cell_y <= cell_of(y + std::max(h, 0)); cell_y++)
+            m_cells[cell_key(cell_x, cell_y)].push_back(key);
+}
+
+
+void Button_grid::remove(uint64_t key, int x, int y, int w, int h)
+{
+    // Il faut redonner le rectangle avec lequel le bouton a été inséré
+    if (is_oversized(x, y, w, h))
+    {
+        m_oversized.erase(std::remove(m_oversized.begin(), m_oversized.end(), key), m_oversized.end());
+        return;
+    }
+
+    for (int cell_x = cell_of(x); cell_x <= cell_of(x + std::max(w, 0)); cell_x++)
+    {
+        for (int cell_y = cell_of(y); cell_y <= cell_of(y + std::max(h, 0)); cell_y++)
+        {
+            auto it = m_cells.find(cell_key(cell_x, cell_y));
+            if (it == m_cells.end())
+                continue;
+
+            it->second.erase(std::remove(it->second.begin(), it->second.end(), key), it->second.end());
+            if (it->second.empty())
+                m_cells.erase(it);
+        }
+    }
+}
+
+
+void Button_grid::query(int x, int y, std::vector<uint64_t> &candidates) const
+{
+    // Candidats : les boutons de la case du point, plus les très grands boutons
+    candidates.clear();
+    auto it = m_cells.find(cell_key(cell_of(x), cell_of(y)));
+    if (it != m_cells.end())
+        candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+    candidates.insert(candidates.end(), m_oversized.begin(), m_oversized.end());
+}
+
+
+void Button_grid::clear()
+{
+    m_cells.clear();
+    m_oversized.clear();
+}
@@ -0,0 +1,41 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_BUTTON_GRID_HPP
+#define MEINCANVAS_BUTTON_GRID_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+// Grille uniforme qui range les boutons par case de l'écran
+// Un clic ne teste que les boutons de la case sous la souris au lieu de toute la liste
+class Button_grid {
+private:
+    int m_cell_size;
+
+    std::unordered_map<uint64_t, std::vector<uint64_t>> m_cells;
+
+    // Les très grands boutons couvriraient trop de cases, ils sont testés à chaque requête
+    std::vector<uint64_t> m_oversized;
+    static constexpr long m_max_cells_per_button = 1024;
+
+private:
+    [[nodiscard]] int cell_of(int coord) const;
+    static uint64_t cell_key(int cell_x, int cell_y);
+    [[nodiscard]] bool is_oversized(int x, int y, int w, int h) const;
+
+public:
+    explicit Button_grid(int cell_size = 64);
+    ~Button_grid() = default;
+
+    void insert(uint64_t key, int x, int y, int w, int h);
+    void remove(uint64_t key, int x, int y, int w, int h);
+    void query(int x, int y, std::vector<uint64_t> &candidates) const;
+    void clear();
+};
+
+
+#endif //MEINCANVAS_BUTTON_GRID_HPP
@@ -6,6 +6,7 @@
 #include "../main_prog/data.hpp"
 
 #include <algorithm>
+#include <array>
 #include <utility>
 
 
@@ -15,93 +16,143 @@ namespace Button_Mutex
 }
 
 
-Buttons::Buttons(std::unique_ptr<Mouse> *mouse, int *window_width, int *window_height)
+Buttons::Buttons(std::unique_ptr<Mouse> *mouse, std::shared_ptr<Event_subscriber> mouse_button_events, int *window_width, int *window_height)
 {
     m_window_width = window_width;
     m_window_height = window_height;
 
     m_mouse_control = mouse;
+    m_mouse_button_events = std::move(mouse_button_events);
 }
 
-bool Buttons::create_button_by_id(std::string id, int x, int y, int w, int h, std::function<void()> pointer_to_function)
+void Buttons::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    m_dispatcher.set_frame_invalidation(frame_invalidation);
+}
+
+void Buttons::set_callback_executor(std::function<void(std::function<void()>)> executor)
+{
+    // En général le pool de threads, les callbacks ne bloquent alors plus le thread des boutons
+    m_dispatcher.set_executor(std::move(executor));
+}
+
+bool Buttons::create_button_by_id(std::string id, int x, int y, int w, int h, std::function<void()> pointer_to_function, int z)
 {
     // Creation des boutons avec les parametres suivants donnés par l'utilisateur
     Button button;
-    button.id = std::move(id);
+    button.id = id;
     button.x = x;
     button.y = y;
     button.w = w;
     button.h = h;
     button.pointer_to_function = std::move(pointer_to_function);
+    button.z = z;
 
     {
         std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
-        size_t size = m_button_list.size();
-        m_button_list.push_back(button);
-        size_t new_size = m_button_list.size();
+        button.order = m_next_order++;
+        Handle handle = m_button_list.insert(std::move(button), id);
 
-        // Si la taille de la liste a changé, alors on a ajouté un bouton
-        if (size != new_size) {
-            return true;
+        // Si la poignée est invalide, un bouton porte déjà cet id
+        if (!handle.is_valid()) {
+            std::cout << "Button " << id << " already exists" << std::endl;
+            return false;
         }
 
-        return false;
+        // On range le bouton dans l'index spatial
+        m_button_list.get(handle)->handle = handle;
+        m_grid.insert(handle.to_key(), x, y, w, h);
+        return true;
     }
 }
 
+Handle Buttons::return_button_handle(const std::string& id) const
+{
+    // Recherche par nom en O(1), la poignée permet ensuite d'accéder au bouton sans comparer de texte
+    std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
+    return m_button_list.find(id);
+}
+
 bool Buttons::edit_button_by_id(const std::string& id, int x, int y, int w, int h, const std::function<void()>& pointer_to_function)
 {
     // Modification des boutons avec les parametres suivants donnés par l'utilisateur
-    // On parcourt la liste des boutons et on modifie celui qui a le meme id que celui donné par l'utilisateur
+    return edit_button(return_button_handle(id), x, y, w, h, pointer_to_function);
+}
+
+bool Buttons::edit_button(Handle handle, int x, int y, int w, int h, const std::function<void()>& pointer_to_function)
+{
     std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
-    for (auto &i : m_button_list)
+    Button *button = m_button_list.get(handle);
+    if (!button)
     {
-        if (i.id == id)
-        {
-            i.x = x;
-            i.y = y;
-            i.w = w;
-            i.h = h;
-            i.pointer_to_function = pointer_to_function;
-
-            return true;
-        }
+        return false;
     }
 
-    return false;
+    // On déplace le bouton dans l'index spatial
+    m_grid.remove(handle.to_key(), button->x, button->y, button->w, button->h);
+    m_grid.insert(handle.to_key(), x, y, w, h);
 
+    button->x = x;
+    button->y = y;
+    button->w = w;
+    button->h = h;
+    button->pointer_to_function = pointer_to_function;
+
+    return true;
 }
 
 bool Buttons::delete_button_by_id(const std::string& id)
 {
     // Suppression des boutons avec les parametres suivants donnés par l'utilisateur
+    return delete_button(return_button_handle(id));
+}
+
+bool Buttons::delete_button(Handle handle)
+{
     std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
-    size_t size = m_button_list.size();
-    m_button_list.erase(std::remove_if(m_button_list.begin(), m_button_list.end(), [id](Button &i){return i.id == id;}), m_button_list.end());
-    size_t new_size = m_button_list.size();
+    Button *button = m_button_list.get(handle);
+    if (!button)
+    {
+        return false;
+    }
+
+    // On retire le bouton de l'index spatial puis de la liste
+    m_grid.remove(handle.to_key(), button->x, button->y, button->w, button->h);
+    return m_button_list.erase(handle);
+}
+
+bool Buttons::set_button_dispatch_by_id(const std::string& id, Callback_dispatch dispatch, bool coalesce)
+{
+    return set_button_dispatch(return_button_handle(id), dispatch, coalesce);
+}
 
-    // Si la taille de la liste a changé, alors on a supprimé un bouton
-    if (size != new_size)
+bool Buttons::set_button_dispatch(Handle handle, Callback_dispatch dispatch, bool coalesce)
+{
+    // dispatch : ORDERED (pool, dans l'ordre), PARALLEL (pool, sans ordre) ou MAIN_THREAD (boucle principale)
+    // coalesce : un clic sur un bouton dont le callback n'a pas encore commencé est ignoré
+    std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
+    Button *button = m_button_list.get(handle);
+    if (!button)
     {
-        return true;
+        return false;
     }
 
-    return false;
+    button->dispatch = dispatch;
+    button->coalesce = coalesce;
+    return true;
 }
 
 Buttons::Button* Buttons::return_button_by_id(const std::string& id)
 {
     // Retourne le bouton avec l'id donné par l'utilisateur
-    // On parcourt la liste des boutons et on retourne celui qui a le meme id que celui donné par l'utilisateur
+    return return_button(return_button_handle(id));
+}
+
+Buttons::Button* Buttons::return_button(Handle handle)
+{
+    // Le pointeur reste valide tant que le bouton existe, les boutons ne bougent jamais en mémoire
     std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
-    for (auto &i : m_button_list)
-    {
-        if (i.id == id)
-        {
-            return &i;
-        }
-    }
-    return nullptr;
+    return m_button_list.get(handle);
 }
 
 bool Buttons::is_button_clicked(Button *button)
@@ -111,36 +162,81 @@ bool Buttons::is_button_clicked(Button *button)
     int x, y;
     (*m_mouse_control)->return_position(&x, &y);
 
-    // Si la position de la souris est dans le rectangle du bouton, alors on appelle la fonction associée au bouton
+    return is_button_clicked(button, x, y);
+}
+
+bool Buttons::is_button_clicked(Button *button, int x, int y)
+{
+    // Si la position est dans le rectangle du bouton, alors on appelle la fonction associée au bouton
     if (x > button->x && x < button->x + button->w && y > button->y && y < button->y + button->h)
     {
-        button->pointer_to_function();
+        // Le callback est confié au dispatcher : il s'exécutera hors du thread des entrées et sans Button_Mutex
+        m_dispatcher.dispatch(button->handle.to_key(), button->pointer_to_function, button->dispatch, button->coalesce);
         return true;
     }
 
     return false;
 }
 
-bool Buttons::check_all_buttons_clicked()
+Buttons::Button* Buttons::find_top_button_at(int x, int y)
 {
-    // On vérifie si le ckick de la souris a été pressé
-    if (!(*m_mouse_control)->left_button_pressed())
+    // On ne teste que les boutons de la case de la grille sous le point
+    // Parmi ceux qui contiennent le point on garde celui du dessus (z, puis le plus récent)
+    m_grid.query(x, y, m_candidates);
+
+    Button *top = nullptr;
+    for (uint64_t key : m_candidates)
     {
-        return false;
+        Button *button = m_button_list.get(Handle::from_key(key));
+        if (!button)
+            continue;
+
+        if (!(x > button->x && x < button->x + button->w && y > button->y && y < button->y + button->h))
+            continue;
+
+        if (!top || button->z > top->z || (button->z == top->z && button->order > top->order))
+            top = button;
     }
-    // On vérifie si un bouton a été cliqué
-    std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
-    for (auto &i : m_button_list)
+
+    return top;
+}
+
+bool Buttons::check_all_buttons_clicked()
+{
+    // On récupère tous les événements de boutons de la souris reçus depuis le dernier passage
+    std::array<SDL_Event, 64> events{};
+    size_t count = m_mouse_button_events->drain_events(events);
+
+    bool clicked = false;
+    for (size_t e = 0; e < count; e++)
     {
-        if (is_button_clicked(&i))
+        // On ne garde que les clics gauches, la position est celle de l'événement (un seul échantillon par clic)
+        if (events[e].type != SDL_MOUSEBUTTONDOWN || events[e].button.button != SDL_BUTTON_LEFT)
+            continue;
+
+        // On vérifie si un bouton a été cliqué
+        std::lock_guard<std::mutex> lock(Button_Mutex::mtx);
+        Button *button = find_top_button_at(events[e].button.x, events[e].button.y);
+        if (button && is_button_clicked(button, events[e].button.x, events[e].button.y))
         {
-            return true;
+            clicked = true;
         }
     }
 
-    return false;
+    return clicked;
+}
+
+
+void Buttons::run_main_thread_callbacks()
+{
+    // À appeler depuis la boucle principale, exécute les callbacks MAIN_THREAD en attente
+    m_dispatcher.run_main_thread_callbacks();
 }
 
+uint64_t Buttons::return_coalesced_clicks_count() const
+{
+    return m_dispatcher.return_coalesced_count();
+}
 
 int Buttons::return_button_list_size() const {
     // On retourne la taille de la liste des boutons
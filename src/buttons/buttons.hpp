@@ -14,6 +14,10 @@
 #include <functional>
 
 #include "../mouse/mouse.hpp"
+#include "../frame/frame_invalidation.hpp"
+#include "button_grid.hpp"
+#include "callback_dispatcher.hpp"
+#include "../registry/registry.hpp"
 
 class Buttons
 {
@@ -24,6 +28,12 @@ private:
 
     std::unique_ptr<Mouse> *m_mouse_control;
 
+    // File des clics souris, seuls les événements de boutons de la souris y arrivent
+    std::shared_ptr<Event_subscriber> m_mouse_button_events;
+
+    // Les callbacks ne sont plus appelés sur le thread des entrées mais confiés au dispatcher
+    Callback_dispatcher m_dispatcher;
+
     struct Button {
         std::string id;
         int x;
@@ -31,24 +41,55 @@ private:
         int w;
         int h;
         std::function<void()> pointer_to_function;
+
+        // Ordre d'affichage : en cas de chevauchement le z le plus grand gagne, puis le bouton le plus récent
+        int z;
+        uint64_t order;
+        Handle handle;
+
+        // Comment le callback est exécuté, et si les clics répétés sont fusionnés
+        Callback_dispatch dispatch = Callback_dispatch::ORDERED;
+        bool coalesce = false;
     };
 
-    std::vector<Button> m_button_list;
+    // Les boutons sont rangés par poignée, l'id texte n'est plus qu'un nom pour les retrouver
+    Registry<Button> m_button_list;
+
+    // Index spatial des boutons, il contient les poignées des boutons
+    Button_grid m_grid;
+    uint64_t m_next_order = 0;
+    std::vector<uint64_t> m_candidates;
+
+private:
+    Button* find_top_button_at(int x, int y);
 
 
 public:
     Buttons() = delete;
-    explicit Buttons(std::unique_ptr<Mouse> *mouse, int *window_width, int *window_height);
+    explicit Buttons(std::unique_ptr<Mouse> *mouse, std::shared_ptr<Event_subscriber> mouse_button_events, int *window_width, int *window_height);
     ~Buttons() = default;
 
-    bool create_button_by_id(std::string id, int x, int y, int w, int h, std::function<void()> pointer_to_function);
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+    void set_callback_executor(std::function<void(std::function<void()>)> executor);
+
+    bool create_button_by_id(std::string id, int x, int y, int w, int h, std::function<void()> pointer_to_function, int z = 0);
     bool edit_button_by_id(const std::string& id, int x, int y, int w, int h, const std::function<void()>& pointer_to_function);
     bool delete_button_by_id(const std::string& id);
+    bool set_button_dispatch_by_id(const std::string& id, Callback_dispatch dispatch, bool coalesce = false);
     Button* return_button_by_id(const std::string& id);
+
+    [[nodiscard]] Handle return_button_handle(const std::string& id) const;
+    bool edit_button(Handle handle, int x, int y, int w, int h, const std::function<void()>& pointer_to_function);
+    bool delete_button(Handle handle);
+    bool set_button_dispatch(Handle handle, Callback_dispatch dispatch, bool coalesce = false);
+    Button* return_button(Handle handle);
     [[nodiscard]] int return_button_list_size() const;
 
     bool is_button_clicked(Button *button);
+    bool is_button_clicked(Button *button, int x, int y);
     bool check_all_buttons_clicked();
+    void run_main_thread_callbacks();
+    [[nodiscard]] uint64_t return_coalesced_clicks_count() const;
 
 
 };
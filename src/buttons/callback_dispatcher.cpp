@@ -0,0 +1,138 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "callback_dispatcher.hpp"
+
+#include <iostream>
+#include <utility>
+
+
+void Callback_dispatcher::set_executor(std::function<void(std::function<void()>)> executor)
+{
+    // À appeler avant le premier clic, sans exécuteur les callbacks sont exécutés sur place
+    m_executor = std::move(executor);
+}
+
+void Callback_dispatcher::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    m_frame_invalidation = frame_invalidation;
+}
+
+
+void Callback_dispatcher::dispatch(uint64_t key, std::function<void()> callback, Callback_dispatch mode, bool coalesce)
+{
+    Pending_callback pending{key, std::move(callback)};
+    bool start_ordered = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        // Si ce bouton a déjà un callback qui n'a pas commencé, le nouveau clic est fusionné avec lui
+        if (coalesce && !m_pending_keys.insert(key).second)
+        {
+            m_coalesced_count++;
+            return;
+        }
+
+        if (mode == Callback_dispatch::MAIN_THREAD)
+        {
+            m_main_thread_queue.push_back(std::move(pending));
+        }
+        else if (mode == Callback_dispatch::ORDERED)
+        {
+            m_ordered_queue.push_back(std::move(pending));
+            // Une seule tâche vide la file ordonnée à la fois, c'est ce qui garantit l'ordre
+            start_ordered = !m_ordered_running;
+            m_ordered_running = true;
+        }
+    }
+
+    switch (mode)
+    {
+        case Callback_dispatch::MAIN_THREAD:
+            // La boucle principale doit se réveiller pour l'exécuter
+            if (m_frame_invalidation)
+                m_frame_invalidation->invalidate();
+            break;
+
+        case Callback_dispatch::ORDERED:
+            if (start_ordered)
+            {
+                if (m_executor)
+                    m_executor([this]() { drain_ordered_queue(); });
+                else
+                    drain_ordered_queue();
+            }
+            break;
+
+        case Callback_dispatch::PARALLEL:
+        default:
+            if (m_executor)
+                m_executor([this, pending = std::move(pending)]() { run_callback(pending); });
+            else
+                run_callback(pending);
+            break;
+    }
+}
+
+
+void Callback_dispatcher::drain_ordered_queue()
+{
+    while (true)
+    {
+        Pending_callback pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mtx);
+            if (m_ordered_queue.empty())
+            {
+                m_ordered_running = false;
+                return;
+            }
+            pending = std::move(m_ordered_queue.front());
+            m_ordered_queue.pop_front();
+        }
+
+        run_callback(pending);
+    }
+}
+
+
+void Callback_dispatcher::run_main_thread_callbacks()
+{
+    // Appelé par la boucle principale : on exécute les callbacks qui demandent le thread principal
+    std::deque<Pending_callback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        callbacks.swap(m_main_thread_queue);
+    }
+
+    for (const auto &pending : callbacks)
+        run_callback(pending);
+}
+
+
+void Callback_dispatcher::run_callback(const Pending_callback &pending)
+{
+    {
+        // Le callback commence : un nouveau clic sur ce bouton ne sera plus fusionné avec lui
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_pending_keys.erase(pending.key);
+    }
+
+    try {
+        pending.callback();
+    } catch (const std::exception &e) {
+        std::cout << "Button callback failed : " << e.what() << std::endl;
+    }
+
+    // Un callback de bouton peut changer la scène
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+}
+
+
+uint64_t Callback_dispatcher::return_coalesced_count() const
+{
+    return m_coalesced_count.load();
+}
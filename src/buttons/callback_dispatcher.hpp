@@ -0,0 +1,69 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_CALLBACK_DISPATCHER_HPP
+#define MEINCANVAS_CALLBACK_DISPATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+#include "../frame/frame_invalidation.hpp"
+
+
+// Où et comment le callback d'un bouton est exécuté
+enum class Callback_dispatch
+{
+    ORDERED,        // Dans le pool, un callback à la fois, dans l'ordre des clics
+    PARALLEL,       // Dans le pool, sans ordre garanti entre les callbacks
+    MAIN_THREAD     // Dans la boucle principale, au début de la frame suivante
+};
+
+
+// Sort les callbacks des boutons du thread des entrées : un callback lent ne bloque plus les clics suivants
+class Callback_dispatcher {
+private:
+    struct Pending_callback {
+        uint64_t key;
+        std::function<void()> callback;
+    };
+
+    // Exécuteur des callbacks asynchrones, en général le pool de threads
+    std::function<void(std::function<void()>)> m_executor;
+    Frame_invalidation *m_frame_invalidation = nullptr;
+
+    std::mutex m_mtx;
+    std::deque<Pending_callback> m_ordered_queue;
+    bool m_ordered_running = false;
+    std::deque<Pending_callback> m_main_thread_queue;
+
+    // Boutons qui ont déjà un callback en attente (pour la fusion des clics répétés)
+    std::unordered_set<uint64_t> m_pending_keys;
+
+    std::atomic<uint64_t> m_coalesced_count = 0;
+
+private:
+    void run_callback(const Pending_callback &pending);
+    void drain_ordered_queue();
+
+public:
+    Callback_dispatcher() = default;
+    Callback_dispatcher(const Callback_dispatcher&) = delete;
+    Callback_dispatcher& operator=(const Callback_dispatcher&) = delete;
+    ~Callback_dispatcher() = default;
+
+    void set_executor(std::function<void(std::function<void()>)> executor);
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+
+    void dispatch(uint64_t key, std::function<void()> callback, Callback_dispatch mode, bool coalesce);
+    void run_main_thread_callbacks();
+
+    [[nodiscard]] uint64_t return_coalesced_count() const;
+};
+
+
+#endif //MEINCANVAS_CALLBACK_DISPATCHER_HPP
@@ -0,0 +1,508 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "display_list.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <tuple>
+
+
+namespace
+{
+    // Au-delà, les zones abîmées sont fusionnées en un seul rectangle
+    constexpr size_t max_damage_rects = 16;
+
+    bool same_color(const SDL_Color &a, const SDL_Color &b)
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    }
+
+    // Modes de mélange de SDL (0, 1, 2, 4, 8) rangés sur 0..4, les modes composés avec SDL_ComposeCustomBlendMode partagent 5
+    // Un simple masque sur 3 bits confondrait SDL_BLENDMODE_MUL (8) avec SDL_BLENDMODE_NONE (0)
+    uint64_t blend_index(SDL_BlendMode blend_mode)
+    {
+        switch (blend_mode)
+        {
+            case SDL_BLENDMODE_NONE: return 0;
+            case SDL_BLENDMODE_BLEND: return 1;
+            case SDL_BLENDMODE_ADD: return 2;
+            case SDL_BLENDMODE_MOD: return 3;
+            case SDL_BLENDMODE_MUL: return 4;
+            default: return 5;
+        }
+    }
+
+    // Clé d'état sur 64 bits : couche (signée, décalée) | mode de mélange | type | couleur repliée sur 26 bits
+    // Deux couleurs peuvent partager une clé, cela ne coûte qu'un changement d'état de plus
+    uint64_t state_key(const Draw_command &command)
+    {
+        uint64_t layer = uint64_t(uint32_t(command.layer) ^ 0x80000000u) << 32;
+        uint64_t blend = blend_index(command.blend_mode) << 29;
+        uint64_t kind = uint64_t(command.kind) << 26;
+        uint64_t color = (uint64_t(command.color.r) << 18) ^ (uint64_t(command.color.g) << 10)
+                         ^ (uint64_t(command.color.b) << 2) ^ uint64_t(command.color.a >> 6);
+        return layer | blend | kind | (color & 0x3FFFFFF);
+    }
+}
+
+
+bool Draw_command::operator==(const Draw_command &other) const
+{
+    if (kind != other.kind || layer != other.layer || blend_mode != other.blend_mode || !same_color(color, other.color))
+        return false;
+
+    if (kind == Draw_command_kind::RECTANGLE)
+        return rect.x == other.rect.x && rect.y == other.rect.y && rect.w == other.rect.w && rect.h == other.rect.h
+               && thickness == other.thickness;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (points[i].x != other.points[i].x || points[i].y != other.points[i].y)
+            return false;
+    }
+
+    return radius == other.radius;
+}
+
+
+Display_list::Display_list(SDL_Renderer *renderer) : m_renderer(renderer), m_batch(renderer)
+{
+}
+
+
+Display_list::~Display_list()
+{
+    if (m_cache)
+        SDL_DestroyTexture(m_cache);
+}
+
+
+void Display_list::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    m_frame_invalidation = frame_invalidation;
+}
+
+
+SDL_Rect Display_list::compute_bounds(const Draw_command &command)
+{
+    // Rectangle (en pixels entiers) qui contient tout ce que la commande peut toucher
+    switch (command.kind)
+    {
+        case Draw_command_kind::RECTANGLE:
+            return command.rect;
+
+        case Draw_command_kind::POINT:
+            return SDL_Rect{int(command.points[0].x), int(command.points[0].y), 1, 1};
+
+        case Draw_command_kind::CIRCLE:
+        {
+            int x = int(std::floor(command.points[0].x - command.radius));
+            int y = int(std::floor(command.points[0].y - command.radius));
+            int size = int(std::ceil(command.radius * 2.0f)) + 2;
+            return SDL_Rect{x, y, size, size};
+        }
+
+        case Draw_command_kind::LINE:
+        case Draw_command_kind::TRIANGLE:
+        default:
+        {
+            int count = command.kind == Draw_command_kind::LINE ? 2 : 3;
+            float min_x = command.points[0].x, max_x = command.points[0].x;
+            float min_y = command.points[0].y, max_y = command.points[0].y;
+            for (int i = 1; i < count; i++)
+            {
+                min_x = std::min(min_x, command.points[i].x);
+                max_x = std::max(max_x, command.points[i].x);
+                min_y = std::min(min_y, command.points[i].y);
+                max_y = std::max(max_y, command.points[i].y);
+            }
+            int x = int(std::floor(min_x)) - 1, y = int(std::floor(min_y)) - 1;
+            return SDL_Rect{x, y, int(std::ceil(max_x)) + 2 - x, int(std::ceil(max_y)) + 2 - y};
+        }
+    }
+}
+
+
+void Display_list::add_damage(const SDL_Rect &rect)
+{
+    if (rect.w <= 0 || rect.h <= 0 || m_full_rebuild)
+        return;
+
+    m_damage.push_back(rect);
+}
+
+
+void Display_list::signal_change()
+{
+    // La frame doit être redessinée (mode de rendu à la demande)
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+}
+
+
+bool Display_list::update_entry(Entry &entry, Handle handle, const Draw_command &command)
+{
+    // Diff avec la commande précédente : identique, il n'y a rien à redessiner
+    if (entry.command == command)
+        return false;
+
+    // Ancienne et nouvelle position sont à redessiner
+    add_damage(entry.bounds);
+    entry.bounds = compute_bounds(command);
+    add_damage(entry.bounds);
+
+    // Un simple déplacement garde la place dans l'ordre de tri, un changement d'état la déplace
+    uint64_t new_state = state_key(command);
+    if (new_state != entry.state)
+    {
+        if (!m_sort_dirty)
+            move_sorted_command(entry, new_state, handle);
+        entry.state = new_state;
+    }
+
+    entry.command = command;
+    return true;
+}
+
+
+Handle Display_list::set_command(const std::string &id, const Draw_command &command)
+{
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        handle = m_commands.find(id);
+        if (!handle.is_valid())
+        {
+            Entry entry{command, compute_bounds(command), m_next_order++, state_key(command)};
+            add_damage(entry.bounds);
+            handle = m_commands.insert(std::move(entry), id);
+            m_sort_dirty = true;
+        }
+        else if (!update_entry(*m_commands.get(handle), handle, command))
+        {
+            return handle;
+        }
+    }
+
+    signal_change();
+    return handle;
+}
+
+
+bool Display_list::set_command(Handle handle, const Draw_command &command)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Entry *entry = m_commands.get(handle);
+        if (!entry)
+            return false;
+
+        if (!update_entry(*entry, handle, command))
+            return true;
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Display_list::delete_command(Handle handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Entry *entry = m_commands.get(handle);
+        if (!entry)
+            return false;
+
+        // Sa clé reste dans m_sorted avec une poignée invalide, elle est ignorée puis retirée au prochain tri
+        add_damage(entry->bounds);
+        m_commands.erase(handle);
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Display_list::delete_command_by_id(const std::string &id)
+{
+    return delete_command(return_command_handle(id));
+}
+
+
+Handle Display_list::return_command_handle(const std::string &id) const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_commands.find(id);
+}
+
+
+void Display_list::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_commands.clear();
+        m_sorted.clear();
+        m_damage.clear();
+        m_sort_dirty = false;
+        m_full_rebuild = true;
+    }
+
+    signal_change();
+}
+
+
+void Display_list::sort_commands()
+{
+    // Le tri regroupe les commandes qui partagent un état, le batch les envoie alors en très peu d'appels
+    m_sorted.clear();
+    m_sorted.reserve(m_commands.size());
+    m_commands.for_each([this](Handle handle, Entry &entry) {
+        m_sorted.push_back(Sort_key{entry.state, entry.order, handle});
+    });
+
+    std::sort(m_sorted.begin(), m_sorted.end(), [](const Sort_key &a, const Sort_key &b) {
+        return a.state < b.state || (a.state == b.state && a.order < b.order);
+    });
+
+    m_sort_dirty = false;
+}
+
+
+void Display_list::move_sorted_command(const Entry &entry, uint64_t new_state, Handle handle)
+{
+    // Recherche dichotomique de l'ancienne place puis de la nouvelle, sans retrier toute la liste
+    auto compare = [](const Sort_key &a, const Sort_key &b) {
+        return a.state < b.state || (a.state == b.state && a.order < b.order);
+    };
+
+    auto old_position = std::lower_bound(m_sorted.begin(), m_sorted.end(), Sort_key{entry.state, entry.order, handle}, compare);
+    if (old_position == m_sorted.end() || !(old_position->handle == handle))
+    {
+        m_sort_dirty = true;
+        return;
+    }
+    m_sorted.erase(old_position);
+
+    Sort_key key{new_state, entry.order, handle};
+    m_sorted.insert(std::lower_bound(m_sorted.begin(), m_sorted.end(), key, compare), key);
+}
+
+
+void Display_list::submit(const Draw_command &command)
+{
+    m_batch.set_blend_mode(command.blend_mode);
+
+    switch (command.kind)
+    {
+        case Draw_command_kind::RECTANGLE:
+            m_batch.draw_rect_outline(command.rect, command.thickness, command.color);
+            break;
+        case Draw_command_kind::LINE:
+            m_batch.draw_line(int(command.points[0].x), int(command.points[0].y), int(command.points[1].x), int(command.points[1].y), command.color);
+            break;
+        case Draw_command_kind::POINT:
+            m_batch.draw_point(int(command.points[0].x), int(command.points[0].y), command.color);
+            break;
+        case Draw_command_kind::TRIANGLE:
+            m_batch.fill_triangle(command.points[0], command.points[1], command.points[2], command.color);
+            break;
+        case Draw_command_kind::CIRCLE:
+            m_batch.fill_circle(command.points[0].x, command.points[0].y, command.radius, command.color);
+            break;
+    }
+
+    m_last_submitted++;
+}
+
+
+bool Display_list::update_cache_size()
+{
+    // La texture cache a la taille de la sortie, elle est recréée (et entièrement redessinée) si la fenêtre change de taille
+    int width = 0, height = 0;
+    SDL_GetRendererOutputSize(m_renderer, &width, &height);
+    if (m_cache && width == m_cache_width && height == m_cache_height)
+        return true;
+
+    if (m_cache)
+        SDL_DestroyTexture(m_cache);
+
+    m_cache = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (!m_cache)
+    {
+        std::cout << "Display list cache could not be created : " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(m_cache, SDL_BLENDMODE_BLEND);
+    m_cache_width = width;
+    m_cache_height = height;
+    m_full_rebuild = true;
+    return true;
+}
+
+
+void Display_list::redraw_cache()
+{
+    // On dessine dans la texture cache, fond transparent pour laisser voir les vidéos dessous
+    SDL_Texture *previous_target = SDL_GetRenderTarget(m_renderer);
+    SDL_SetRenderTarget(m_renderer, m_cache);
+
+    Uint8 r, g, b, a;
+    SDL_BlendMode previous_blend_mode;
+    SDL_GetRenderDrawColor(m_renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(m_renderer, &previous_blend_mode);
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 0);
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
+
+    if (m_full_rebuild)
+    {
+        SDL_RenderClear(m_renderer);
+        SDL_SetRenderDrawColor(m_renderer, r, g, b, a);
+        SDL_SetRenderDrawBlendMode(m_renderer, previous_blend_mode);
+
+        for (const auto &key : m_sorted)
+        {
+            if (const Entry *entry = m_commands.get(key.handle))
+                submit(entry->command);
+        }
+        m_batch.flush();
+        m_last_draw_calls += m_batch.return_last_draw_calls();
+
+        m_last_damage.assign(1, SDL_Rect{0, 0, m_cache_width, m_cache_height});
+    }
+    else
+    {
+        // Trop de petites zones : on les fusionne en une seule
+        if (m_damage.size() > max_damage_rects)
+        {
+            SDL_Rect merged = m_damage[0];
+            for (size_t i = 1; i < m_damage.size(); i++)
+                SDL_UnionRect(&merged, &m_damage[i], &merged);
+            m_damage.assign(1, merged);
+        }
+
+        // Pour chaque zone abîmée : on l'efface (SDL_RenderClear ignore le clip) puis on redessine seulement les commandes qui la touchent
+        for (const auto &damage : m_damage)
+        {
+            SDL_RenderSetClipRect(m_renderer, &damage);
+            SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 0);
+            SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
+            SDL_RenderFillRect(m_renderer, &damage);
+            SDL_SetRenderDrawColor(m_renderer, r, g, b, a);
+            SDL_SetRenderDrawBlendMode(m_renderer, previous_blend_mode);
+
+            for (const auto &key : m_sorted)
+            {
+                const Entry *entry = m_commands.get(key.handle);
+                if (entry && SDL_HasIntersection(&entry->bounds, &damage))
+                    submit(entry->command);
+            }
+            m_batch.flush();
+            m_last_draw_calls += m_batch.return_last_draw_calls() + 1;
+        }
+        SDL_RenderSetClipRect(m_renderer, nullptr);
+
+        m_last_damage = m_damage;
+    }
+
+    SDL_SetRenderTarget(m_renderer, previous_target);
+}
+
+
+void Display_list::update()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_last_submitted = 0;
+    m_last_draw_calls = 0;
+    m_last_damage.clear();
+
+    // Liste vide : pas de texture cache, elle sera recréée (et entièrement redessinée) au premier ajout
+    if (m_commands.size() == 0)
+    {
+        if (m_cache)
+        {
+            SDL_DestroyTexture(m_cache);
+            m_cache = nullptr;
+            m_cache_width = 0;
+            m_cache_height = 0;
+        }
+        m_damage.clear();
+        m_full_rebuild = false;
+        return;
+    }
+
+    if (!update_cache_size())
+        return;
+
+    if (m_sort_dirty)
+        sort_commands();
+
+    // Rien n'a changé depuis la frame précédente : la texture cache reste telle quelle
+    if (m_full_rebuild || !m_damage.empty())
+        redraw_cache();
+
+    m_damage.clear();
+    m_full_rebuild = false;
+}
+
+
+void Display_list::composite()
+{
+    // Copie de la texture cache sur la cible courante, limitée par le clip courant du renderer
+    // Liste vide : rien à mélanger, ce qui évite une copie plein écran par zone abîmée avec le renderer logiciel
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_cache || m_commands.size() == 0)
+        return;
+
+    SDL_RenderCopy(m_renderer, m_cache, nullptr, nullptr);
+    m_last_draw_calls++;
+}
+
+
+void Display_list::render()
+{
+    update();
+    composite();
+}
+
+
+bool Display_list::append_pending_damage(std::vector<SDL_Rect> &rects) const
+{
+    // Zones que la prochaine mise à jour va redessiner, renvoie true si c'est toute la liste
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_full_rebuild)
+        return true;
+
+    rects.insert(rects.end(), m_damage.begin(), m_damage.end());
+    return false;
+}
+
+
+size_t Display_list::return_commands_size() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_commands.size();
+}
+
+size_t Display_list::return_last_submitted_count() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_last_submitted;
+}
+
+size_t Display_list::return_last_draw_calls() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_last_draw_calls;
+}
+
+std::vector<SDL_Rect> Display_list::return_last_damage() const
+{
+    // Zones de l'écran qui ont changé à la dernière frame, utile pour ne recomposer que ces zones
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_last_damage;
+}
@@ -0,0 +1,135 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_DISPLAY_LIST_HPP
+#define MEINCANVAS_DISPLAY_LIST_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "draw_batch.hpp"
+#include "../frame/frame_invalidation.hpp"
+#include "../registry/registry.hpp"
+
+
+enum class Draw_command_kind
+{
+    RECTANGLE,      // rect + thickness (contour), plein si thickness couvre le rectangle
+    LINE,           // points[0] -> points[1]
+    POINT,          // points[0]
+    TRIANGLE,       // points[0], points[1], points[2]
+    CIRCLE          // centre points[0], radius
+};
+
+// Commande de dessin retenue : elle reste dans la liste d'une frame à l'autre jusqu'à sa suppression
+struct Draw_command
+{
+    Draw_command_kind kind = Draw_command_kind::RECTANGLE;
+
+    // Les couches sont dessinées de la plus basse à la plus haute
+    // Dans une couche l'ordre suit l'état de rendu, il faut donc changer de couche quand le recouvrement compte
+    int layer = 0;
+    SDL_BlendMode blend_mode = SDL_BLENDMODE_NONE;
+    SDL_Color color{255, 255, 255, 255};
+
+    SDL_Rect rect{0, 0, 0, 0};
+    int thickness = 0;
+    SDL_FPoint points[3]{};
+    float radius = 0.0f;
+
+    bool operator==(const Draw_command &other) const;
+};
+
+
+// Liste d'affichage retenue : les commandes ont des id stables, sont triées par couche et par état
+// de rendu, et sont dessinées dans une texture cache
+// Une commande modifiée n'abîme que la zone qu'elle couvrait et celle qu'elle couvre maintenant :
+// seule cette zone de la texture est effacée et redessinée, les commandes inchangées ne sont jamais renvoyées
+class Display_list {
+private:
+    struct Entry {
+        Draw_command command;
+        SDL_Rect bounds;
+        uint64_t order;
+        uint64_t state;
+    };
+
+    SDL_Renderer *m_renderer;
+    Draw_batch m_batch;
+    Frame_invalidation *m_frame_invalidation = nullptr;
+
+    mutable std::mutex m_mtx;
+    Registry<Entry> m_commands;
+    uint64_t m_next_order = 0;
+
+    // Commandes triées par (couche, mode de mélange, type, couleur, ordre)
+    // Trié en entier après des ajouts, une commande qui change d'état est seulement déplacée à sa nouvelle place
+    // Les commandes supprimées y restent jusqu'au prochain tri, leur poignée n'est plus valide
+    struct Sort_key {
+        uint64_t state;
+        uint64_t order;
+        Handle handle;
+    };
+    std::vector<Sort_key> m_sorted;
+    bool m_sort_dirty = false;
+
+    // Zones de la texture cache à redessiner à la prochaine frame
+    std::vector<SDL_Rect> m_damage;
+    bool m_full_rebuild = true;
+
+    SDL_Texture *m_cache = nullptr;
+    int m_cache_width = 0;
+    int m_cache_height = 0;
+
+    // Statistiques de la dernière frame
+    size_t m_last_submitted = 0;
+    size_t m_last_draw_calls = 0;
+    std::vector<SDL_Rect> m_last_damage;
+
+private:
+    static SDL_Rect compute_bounds(const Draw_command &command);
+    void add_damage(const SDL_Rect &rect);
+    bool update_entry(Entry &entry, Handle handle, const Draw_command &command);
+    void sort_commands();
+    void move_sorted_command(const Entry &entry, uint64_t new_state, Handle handle);
+    void submit(const Draw_command &command);
+    bool update_cache_size();
+    void redraw_cache();
+    void signal_change();
+
+public:
+    Display_list() = delete;
+    explicit Display_list(SDL_Renderer *renderer);
+    Display_list(const Display_list&) = delete;
+    Display_list& operator=(const Display_list&) = delete;
+    ~Display_list();
+
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+
+    // Ajoute ou remplace la commande 'id', une commande identique à la précédente ne change rien
+    Handle set_command(const std::string &id, const Draw_command &command);
+    bool set_command(Handle handle, const Draw_command &command);
+    bool delete_command(Handle handle);
+    bool delete_command_by_id(const std::string &id);
+    [[nodiscard]] Handle return_command_handle(const std::string &id) const;
+    void clear();
+
+    // Met à jour les zones abîmées de la texture cache puis la copie sur la cible courante
+    void render();
+    void update();
+    void composite();
+    bool append_pending_damage(std::vector<SDL_Rect> &rects) const;
+
+    [[nodiscard]] size_t return_commands_size() const;
+    [[nodiscard]] size_t return_last_submitted_count() const;
+    [[nodiscard]] size_t return_last_draw_calls() const;
+    [[nodiscard]] std::vector<SDL_Rect> return_last_damage() const;
+};
+
+
+#endif //MEINCANVAS_DISPLAY_LIST_HPP
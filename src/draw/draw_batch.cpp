@@ -0,0 +1,340 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "draw_batch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+    constexpr float pi = 3.14159265358979f;
+}
+
+
+Draw_batch::Draw_batch(SDL_Renderer *renderer) : m_renderer(renderer)
+{
+    // On réserve pour quelques milliers de widgets, la file ne réalloue plus en régime établi
+    m_runs.reserve(64);
+    m_rects.reserve(4096);
+    m_vertices.reserve(8192);
+    m_indices.reserve(12288);
+}
+
+
+void Draw_batch::set_blend_mode(SDL_BlendMode blend_mode)
+{
+    m_blend_mode = blend_mode;
+}
+
+
+Draw_batch::Run *Draw_batch::open_rect_run(SDL_Color color)
+{
+    if (!m_runs.empty())
+    {
+        Run &last = m_runs.back();
+        if (last.blend_mode == m_blend_mode)
+        {
+            // Même couleur que le run de rectangles en cours : on le prolonge
+            if (last.kind == Run_kind::RECTS && last.color.r == color.r && last.color.g == color.g
+                && last.color.b == color.b && last.color.a == color.a)
+                return &last;
+
+            // Sinon le rectangle rejoint la géométrie, qui porte sa couleur par sommet : un seul appel pour toutes les couleurs
+            return nullptr;
+        }
+    }
+
+    m_runs.push_back(Run{Run_kind::RECTS, color, m_blend_mode, m_rects.size(), 0, 0, 0});
+    return &m_runs.back();
+}
+
+
+Draw_batch::Run *Draw_batch::open_geometry_run()
+{
+    if (!m_runs.empty() && m_runs.back().kind == Run_kind::GEOMETRY && m_runs.back().blend_mode == m_blend_mode)
+        return &m_runs.back();
+
+    m_runs.push_back(Run{Run_kind::GEOMETRY, SDL_Color{0, 0, 0, 0}, m_blend_mode, m_vertices.size(), 0, m_indices.size(), 0});
+    return &m_runs.back();
+}
+
+
+void Draw_batch::push_quad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, SDL_Color color)
+{
+    // Quadrilatère (x0,y0) -> (x1,y1) -> (x2,y2) -> (x3,y3), découpé en deux triangles
+    Run *run = open_geometry_run();
+    int base = int(run->count);
+
+    size_t first_vertex = m_vertices.size();
+    m_vertices.resize(first_vertex + 4);
+    SDL_Vertex *vertices = &m_vertices[first_vertex];
+    vertices[0] = SDL_Vertex{{x0, y0}, color, {0.0f, 0.0f}};
+    vertices[1] = SDL_Vertex{{x1, y1}, color, {0.0f, 0.0f}};
+    vertices[2] = SDL_Vertex{{x2, y2}, color, {0.0f, 0.0f}};
+    vertices[3] = SDL_Vertex{{x3, y3}, color, {0.0f, 0.0f}};
+
+    size_t first_index = m_indices.size();
+    m_indices.resize(first_index + 6);
+    int *indices = &m_indices[first_index];
+    indices[0] = base;
+    indices[1] = base + 1;
+    indices[2] = base + 2;
+    indices[3] = base;
+    indices[4] = base + 2;
+    indices[5] = base + 3;
+
+    run->count += 4;
+    run->index_count += 6;
+}
+
+
+void Draw_batch::fill_rect(const SDL_Rect &rect, SDL_Color color)
+{
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+
+    m_primitives++;
+
+    Run *run = open_rect_run(color);
+    if (run)
+    {
+        m_rects.push_back(rect);
+        run->count++;
+        return;
+    }
+
+    // Le run en cours n'a pas la même couleur, le rectangle part dans la géométrie
+    auto x = float(rect.x), y = float(rect.y), w = float(rect.w), h = float(rect.h);
+    push_quad(x, y, x + w, y, x + w, y + h, x, y + h, color);
+}
+
+
+void Draw_batch::draw_rect_outline(const SDL_Rect &rect, int thickness, SDL_Color color)
+{
+    // Un contour épais est fait de 4 rectangles pleins (haut, bas, gauche, droite) au lieu d'un contour par pixel d'épaisseur
+    if (thickness <= 0 || rect.w <= 0 || rect.h <= 0)
+        return;
+
+    if (thickness * 2 >= rect.w || thickness * 2 >= rect.h)
+    {
+        fill_rect(rect, color);
+        return;
+    }
+
+    fill_rect({rect.x, rect.y, rect.w, thickness}, color);
+    fill_rect({rect.x, rect.y + rect.h - thickness, rect.w, thickness}, color);
+    fill_rect({rect.x, rect.y + thickness, thickness, rect.h - 2 * thickness}, color);
+    fill_rect({rect.x + rect.w - thickness, rect.y + thickness, thickness, rect.h - 2 * thickness}, color);
+}
+
+
+void Draw_batch::draw_line(int x1, int y1, int x2, int y2, SDL_Color color)
+{
+    // Les lignes horizontales et verticales sont des rectangles d'un pixel de large
+    if (x1 == x2 || y1 == y2)
+    {
+        fill_rect({std::min(x1, x2), std::min(y1, y2), std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1}, color);
+        return;
+    }
+
+    // Les autres deviennent un quadrilatère d'un pixel d'épaisseur
+    m_primitives++;
+    float dx = float(x2 - x1), dy = float(y2 - y1);
+    float length = std::sqrt(dx * dx + dy * dy);
+    float nx = -dy / length * 0.5f, ny = dx / length * 0.5f;
+    float ax = float(x1) + 0.5f, ay = float(y1) + 0.5f, bx = float(x2) + 0.5f, by = float(y2) + 0.5f;
+    push_quad(ax + nx, ay + ny, bx + nx, by + ny, bx - nx, by - ny, ax - nx, ay - ny, color);
+}
+
+
+void Draw_batch::draw_point(int x, int y, SDL_Color color)
+{
+    fill_rect({x, y, 1, 1}, color);
+}
+
+
+void Draw_batch::fill_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_Color color)
+{
+    m_primitives++;
+
+    Run *run = open_geometry_run();
+    int base = int(run->count);
+
+    m_vertices.push_back(SDL_Vertex{a, color, {0.0f, 0.0f}});
+    m_vertices.push_back(SDL_Vertex{b, color, {0.0f, 0.0f}});
+    m_vertices.push_back(SDL_Vertex{c, color, {0.0f, 0.0f}});
+    m_indices.insert(m_indices.end(), {base, base + 1, base + 2});
+
+    run->count += 3;
+    run->index_count += 3;
+}
+
+
+void Draw_batch::fill_convex_polygon(const SDL_FPoint *points, int count, SDL_Color color)
+{
+    // Éventail de triangles autour du premier sommet, valable pour les polygones convexes
+    if (count < 3)
+        return;
+
+    m_primitives++;
+
+    Run *run = open_geometry_run();
+    int base = int(run->count);
+
+    for (int i = 0; i < count; i++)
+        m_vertices.push_back(SDL_Vertex{points[i], color, {0.0f, 0.0f}});
+
+    for (int i = 1; i < count - 1; i++)
+        m_indices.insert(m_indices.end(), {base, base + i, base + i + 1});
+
+    run->count += size_t(count);
+    run->index_count += size_t(count - 2) * 3;
+}
+
+
+void Draw_batch::fill_circle(float center_x, float center_y, float radius, SDL_Color color)
+{
+    if (radius <= 0.0f)
+        return;
+
+    m_primitives++;
+
+    // Nombre de segments proportionnel au rayon, l'écart à l'arc reste sous le quart de pixel
+    int segments = std::clamp(int(std::ceil(pi / std::acos(std::max(1.0f - 0.25f / radius, -1.0f)))), 8, 256);
+
+    Run *run = open_geometry_run();
+    int base = int(run->count);
+
+    // Les sommets du bord sont obtenus par rotations successives, sans cos/sin par sommet
+    float step_cos = std::cos(2.0f * pi / float(segments)), step_sin = std::sin(2.0f * pi / float(segments));
+    float dx = radius, dy = 0.0f;
+
+    m_vertices.push_back(SDL_Vertex{{center_x, center_y}, color, {0.0f, 0.0f}});
+    for (int i = 0; i < segments; i++)
+    {
+        m_vertices.push_back(SDL_Vertex{{center_x + dx, center_y + dy}, color, {0.0f, 0.0f}});
+        float next_dx = dx * step_cos - dy * step_sin;
+        dy = dx * step_sin + dy * step_cos;
+        dx = next_dx;
+    }
+
+    size_t first_index = m_indices.size();
+    m_indices.resize(first_index + size_t(segments) * 3);
+    int *indices = &m_indices[first_index];
+    for (int i = 0; i < segments; i++)
+    {
+        indices[i * 3] = base;
+        indices[i * 3 + 1] = base + 1 + i;
+        indices[i * 3 + 2] = base + 1 + (i + 1 == segments ? 0 : i + 1);
+    }
+
+    run->count += size_t(segments) + 1;
+    run->index_count += size_t(segments) * 3;
+}
+
+
+void Draw_batch::flush()
+{
+    submit();
+    clear();
+}
+
+
+void Draw_batch::submit()
+{
+    m_last_draw_calls = 0;
+    m_last_primitives = m_primitives;
+
+    if (m_runs.empty())
+        return;
+
+    // On garde l'état du renderer pour le rendre tel quel (SDL_RenderClear utilise la couleur courante)
+    Uint8 r, g, b, a;
+    SDL_BlendMode previous_blend_mode;
+    SDL_GetRenderDrawColor(m_renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(m_renderer, &previous_blend_mode);
+
+    SDL_BlendMode blend_mode = previous_blend_mode;
+    for (const auto &run : m_runs)
+    {
+        if (run.count == 0)
+            continue;
+
+        if (run.blend_mode != blend_mode)
+        {
+            SDL_SetRenderDrawBlendMode(m_renderer, run.blend_mode);
+            blend_mode = run.blend_mode;
+        }
+
+        if (run.kind == Run_kind::RECTS)
+        {
+            SDL_SetRenderDrawColor(m_renderer, run.color.r, run.color.g, run.color.b, run.color.a);
+            SDL_RenderFillRects(m_renderer, &m_rects[run.first], int(run.count));
+        } else {
+            SDL_RenderGeometry(m_renderer, nullptr, &m_vertices[run.first], int(run.count),
+                               &m_indices[run.first_index], int(run.index_count));
+        }
+        m_last_draw_calls++;
+    }
+
+    SDL_SetRenderDrawColor(m_renderer, r, g, b, a);
+    SDL_SetRenderDrawBlendMode(m_renderer, previous_blend_mode);
+}
+
+
+void Draw_batch::clear()
+{
+    // On garde la mémoire des vecteurs pour la frame suivante
+    m_runs.clear();
+    m_rects.clear();
+    m_vertices.clear();
+    m_indices.clear();
+    m_primitives = 0;
+}
+
+
+bool Draw_batch::return_bounds(SDL_Rect &bounds) const
+{
+    // Rectangle qui englobe toutes les primitives en file, calculé à la demande pour ne rien coûter à l'ajout
+    if (m_rects.empty() && m_vertices.empty())
+        return false;
+
+    float min_x = 1e9f, min_y = 1e9f, max_x = -1e9f, max_y = -1e9f;
+    for (const auto &rect : m_rects)
+    {
+        min_x = std::min(min_x, float(rect.x));
+        min_y = std::min(min_y, float(rect.y));
+        max_x = std::max(max_x, float(rect.x + rect.w));
+        max_y = std::max(max_y, float(rect.y + rect.h));
+    }
+    for (const auto &vertex : m_vertices)
+    {
+        min_x = std::min(min_x, vertex.position.x);
+        min_y = std::min(min_y, vertex.position.y);
+        max_x = std::max(max_x, vertex.position.x);
+        max_y = std::max(max_y, vertex.position.y);
+    }
+
+    int x = int(std::floor(min_x)) - 1, y = int(std::floor(min_y)) - 1;
+    bounds = SDL_Rect{x, y, int(std::ceil(max_x)) + 1 - x, int(std::ceil(max_y)) + 1 - y};
+    return true;
+}
+
+
+size_t Draw_batch::return_last_draw_calls() const
+{
+    return m_last_draw_calls;
+}
+
+size_t Draw_batch::return_last_primitives() const
+{
+    return m_last_primitives;
+}
+
+size_t Draw_batch::return_queued_primitives() const
+{
+    return m_primitives;
+}
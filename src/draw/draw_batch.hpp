@@ -0,0 +1,87 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_DRAW_BATCH_HPP
+#define MEINCANVAS_DRAW_BATCH_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+
+// File de primitives à dessiner, envoyées au renderer en un minimum d'appels par flush()
+// Les primitives consécutives qui partagent le même état sont regroupées dans un même "run" :
+//  - RECTS    : rectangles pleins d'une seule couleur -> un SDL_RenderFillRects
+//  - GEOMETRY : triangles avec une couleur par sommet -> un SDL_RenderGeometry, quelle que soit la couleur
+// L'ordre de dessin est conservé, on ne regroupe jamais deux primitives séparées par un changement d'état
+class Draw_batch {
+private:
+    enum class Run_kind
+    {
+        RECTS,
+        GEOMETRY
+    };
+
+    struct Run {
+        Run_kind kind;
+        SDL_Color color;            // Seulement pour RECTS, GEOMETRY porte la couleur dans ses sommets
+        SDL_BlendMode blend_mode;
+
+        size_t first;               // Premier rectangle ou premier sommet du run
+        size_t count;
+        size_t first_index;         // Seulement pour GEOMETRY, les indices sont relatifs au premier sommet du run
+        size_t index_count;
+    };
+
+    SDL_Renderer *m_renderer;
+
+    std::vector<Run> m_runs;
+    std::vector<SDL_Rect> m_rects;
+    std::vector<SDL_Vertex> m_vertices;
+    std::vector<int> m_indices;
+
+    SDL_BlendMode m_blend_mode = SDL_BLENDMODE_NONE;
+
+    // Statistiques du dernier flush
+    size_t m_last_draw_calls = 0;
+    size_t m_last_primitives = 0;
+    size_t m_primitives = 0;
+
+private:
+    Run *open_rect_run(SDL_Color color);
+    Run *open_geometry_run();
+    void push_quad(float x0, float y0, float x1, float y1, float x2, float y2, float x3, float y3, SDL_Color color);
+
+public:
+    Draw_batch() = delete;
+    explicit Draw_batch(SDL_Renderer *renderer);
+    ~Draw_batch() = default;
+
+    // Mode de mélange appliqué aux primitives ajoutées ensuite
+    void set_blend_mode(SDL_BlendMode blend_mode);
+
+    void fill_rect(const SDL_Rect &rect, SDL_Color color);
+    void draw_rect_outline(const SDL_Rect &rect, int thickness, SDL_Color color);
+    void draw_line(int x1, int y1, int x2, int y2, SDL_Color color);
+    void draw_point(int x, int y, SDL_Color color);
+    void fill_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, SDL_Color color);
+    void fill_convex_polygon(const SDL_FPoint *points, int count, SDL_Color color);
+    void fill_circle(float center_x, float center_y, float radius, SDL_Color color);
+
+    // Envoie toutes les primitives au renderer puis vide la file, à appeler avant SDL_RenderPresent
+    void flush();
+    // Envoie les primitives sans vider la file, pour les redessiner dans plusieurs zones de clip
+    void submit();
+    void clear();
+
+    [[nodiscard]] bool return_bounds(SDL_Rect &bounds) const;
+
+    [[nodiscard]] size_t return_last_draw_calls() const;
+    [[nodiscard]] size_t return_last_primitives() const;
+    [[nodiscard]] size_t return_queued_primitives() const;
+};
+
+
+#endif //MEINCANVAS_DRAW_BATCH_HPP
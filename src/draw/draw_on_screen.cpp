@@ -4,8 +4,23 @@
 
 #include "draw_on_screen.hpp"
 
+#include <cmath>
+#include <iostream>
+
+
+namespace
+{
+    constexpr float pi = 3.14159265358979f;
+
+    SDL_Color to_sdl_color(Color color, int alpha)
+    {
+        return SDL_Color{Uint8(color.r), Uint8(color.g), Uint8(color.b), Uint8(alpha)};
+    }
+}
+
+
 Draw_on_screen::Draw_on_screen(SDL_Renderer *renderer, SDL_Rect *rect, int *w, int *h)
-    : m_renderer(renderer), m_rect(rect), m_window_width(w), m_window_height(h)
+    : m_renderer(renderer), m_rect(rect), m_window_width(w), m_window_height(h), m_batch(renderer), m_text(renderer), m_layers(renderer), m_display_list(renderer), m_framebuffer(renderer)
 {
     set_color(Color(255, 255, 255), 255);
 }
@@ -14,6 +29,48 @@ Draw_on_screen::Draw_on_screen(SDL_Renderer *renderer, SDL_Rect *rect, int *w, i
 void Draw_on_screen::set_color(Color color, int alpha)
 {
     SDL_SetRenderDrawColor(m_renderer, color.r, color.g, color.b, alpha);
+
+    // Couleur de fond du framebuffer, qui est opaque : elle n'est appliquée qu'à la prochaine frame par begin_frame
+    m_background = Framebuffer::to_argb(to_sdl_color(color, 255));
+}
+
+
+void Draw_on_screen::set_framebuffer_mode(bool enabled)
+{
+    m_framebuffer_mode = enabled;
+}
+
+
+bool Draw_on_screen::return_framebuffer_mode() const
+{
+    return m_framebuffer_mode;
+}
+
+
+Simd_level Draw_on_screen::return_simd_level() const
+{
+    return m_framebuffer.return_simd_level();
+}
+
+
+void Draw_on_screen::begin_frame(int width, int height)
+{
+    if (!m_framebuffer_mode)
+        return;
+
+    // L'image est recréée uniquement si la taille de sortie change
+    if (!m_framebuffer.resize(width, height, m_background))
+    {
+        m_framebuffer_mode = false;
+        return;
+    }
+
+    // Le fond a changé depuis la frame précédente : on l'applique avant toute primitive de la frame
+    if (m_framebuffer_background != m_background)
+    {
+        m_framebuffer.clear(m_background);
+        m_framebuffer_background = m_background;
+    }
 }
 
 
@@ -28,24 +85,314 @@ void Draw_on_screen::draw_rectangle(int x, int y, int width, int height, Color c
     Square_Color : couleur
     */
 
-    set_color(color, alpha);
+    // Les contours emboîtés de 1 à radius forment une bordure d'épaisseur radius : 4 rectangles pleins, ou 1 si le rectangle est plein
+    SDL_Rect rect{x + 1, y + 1, width - 2, height - 2};
+    if (m_framebuffer_mode)
+        m_framebuffer.draw_rect_outline(rect, clamp_radius(width, height, radius), Framebuffer::to_argb(to_sdl_color(color, alpha)));
+    else
+        m_batch.draw_rect_outline(rect, clamp_radius(width, height, radius), to_sdl_color(color, alpha));
+}
+
+
+void Draw_on_screen::draw_rounded_rectangle(int x, int y, int width, int height, int corner_radius, Color color, int alpha)
+{
+    corner_radius = std::clamp(corner_radius, 0, std::min(width, height) / 2);
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (m_framebuffer_mode)
+    {
+        m_framebuffer.fill_rounded_rect({x, y, width, height}, corner_radius, Framebuffer::to_argb(to_sdl_color(color, alpha)));
+        return;
+    }
+
+    // Sans framebuffer : un polygone convexe avec un quart de cercle par coin
+    const int segments = std::max(2, corner_radius / 2);
+    std::vector<SDL_FPoint> points;
+    points.reserve(size_t(segments + 1) * 4);
+
+    const float centers[4][2] = {
+        {float(x + width - corner_radius), float(y + height - corner_radius)},
+        {float(x + corner_radius), float(y + height - corner_radius)},
+        {float(x + corner_radius), float(y + corner_radius)},
+        {float(x + width - corner_radius), float(y + corner_radius)},
+    };
+    for (int corner = 0; corner < 4; corner++)
+    {
+        for (int i = 0; i <= segments; i++)
+        {
+            float angle = pi * 0.5f * (float(corner) + float(i) / float(segments));
+            points.push_back({centers[corner][0] + std::cos(angle) * float(corner_radius), centers[corner][1] + std::sin(angle) * float(corner_radius)});
+        }
+    }
+
+    m_batch.fill_convex_polygon(points.data(), int(points.size()), to_sdl_color(color, alpha));
+}
+
 
+bool Draw_on_screen::draw_image_scaled(const uint32_t *pixels, int width, int height, int pitch, SDL_Rect dst)
+{
+    if (!m_framebuffer_mode)
+    {
+        std::cout << "draw_image_scaled needs the framebuffer mode" << std::endl;
+        return false;
+    }
+
+    m_framebuffer.blit_scaled(pixels, width, height, pitch, dst);
+    return true;
+}
+
+
+int Draw_on_screen::clamp_radius(int width, int height, int radius)
+{
     if (radius == -1) {
         radius = std::min(width, height) / 2;
     } else if (radius > width / 2 || radius > height / 2) {
         radius = std::min({radius, width / 2, height / 2});
     }
 
-    for (int i = 1; i <= radius; i++)
+    return radius;
+}
+
+
+void Draw_on_screen::draw_line(int x1, int y1, int x2, int y2, Color color, int alpha)
+{
+    if (m_framebuffer_mode)
+        m_framebuffer.draw_line(x1, y1, x2, y2, Framebuffer::to_argb(to_sdl_color(color, alpha)));
+    else
+        m_batch.draw_line(x1, y1, x2, y2, to_sdl_color(color, alpha));
+}
+
+
+void Draw_on_screen::draw_point(int x, int y, Color color, int alpha)
+{
+    if (m_framebuffer_mode)
+        m_framebuffer.draw_point(x, y, Framebuffer::to_argb(to_sdl_color(color, alpha)));
+    else
+        m_batch.draw_point(x, y, to_sdl_color(color, alpha));
+}
+
+
+void Draw_on_screen::draw_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, Color color, int alpha)
+{
+    if (m_framebuffer_mode)
+        m_framebuffer.fill_triangle(a, b, c, Framebuffer::to_argb(to_sdl_color(color, alpha)));
+    else
+        m_batch.fill_triangle(a, b, c, to_sdl_color(color, alpha));
+}
+
+
+void Draw_on_screen::draw_circle(float center_x, float center_y, float radius, Color color, int alpha)
+{
+    if (m_framebuffer_mode)
+        m_framebuffer.fill_circle(int(std::lround(center_x)), int(std::lround(center_y)), int(std::lround(radius)), Framebuffer::to_argb(to_sdl_color(color, alpha)));
+    else
+        m_batch.fill_circle(center_x, center_y, radius, to_sdl_color(color, alpha));
+}
+
+
+void Draw_on_screen::set_blend_mode(SDL_BlendMode blend_mode)
+{
+    // Par défaut SDL_BLENDMODE_NONE, comme le renderer : l'alpha n'est pris en compte qu'avec SDL_BLENDMODE_BLEND
+    m_batch.set_blend_mode(blend_mode);
+}
+
+
+Handle Draw_on_screen::load_font_by_id(const std::string &id, const std::string &path, int size)
+{
+    return m_text.load_font(id, path, size);
+}
+
+
+bool Draw_on_screen::draw_text(const std::string &font_id, const std::string &text, int x, int y, Color color, int alpha)
+{
+    return draw_text(m_text.return_font_handle(font_id), text, x, y, color, alpha);
+}
+
+
+bool Draw_on_screen::draw_text(Handle font, const std::string &text, int x, int y, Color color, int alpha)
+{
+    // Le texte n'est envoyé qu'au composite, en un appel par page de l'atlas
+    return m_text.draw_text(font, text, x, y, to_sdl_color(color, alpha));
+}
+
+
+Text_renderer &Draw_on_screen::return_text_renderer()
+{
+    return m_text;
+}
+
+
+Handle Draw_on_screen::set_rectangle_by_id(const std::string &id, int layer, int x, int y, int width, int height, Color color, int alpha, int radius)
+{
+    // Même rendu que draw_rectangle, mais la commande n'est renvoyée au renderer que si elle change
+    Draw_command command;
+    command.kind = Draw_command_kind::RECTANGLE;
+    command.layer = layer;
+    command.color = to_sdl_color(color, alpha);
+    command.rect = {x + 1, y + 1, width - 2, height - 2};
+    command.thickness = clamp_radius(width, height, radius);
+
+    return m_display_list.set_command(id, command);
+}
+
+
+Handle Draw_on_screen::set_command_by_id(const std::string &id, const Draw_command &command)
+{
+    return m_display_list.set_command(id, command);
+}
+
+
+bool Draw_on_screen::delete_command_by_id(const std::string &id)
+{
+    return m_display_list.delete_command_by_id(id);
+}
+
+
+Display_list &Draw_on_screen::return_display_list()
+{
+    return m_display_list;
+}
+
+
+Handle Draw_on_screen::set_layer_by_id(const std::string &id, int z_order, SDL_Rect area, Layer_cache::Draw_function draw)
+{
+    return m_layers.set_layer(id, z_order, area, std::move(draw));
+}
+
+
+bool Draw_on_screen::invalidate_layer_by_id(const std::string &id)
+{
+    return m_layers.invalidate_layer_by_id(id);
+}
+
+
+bool Draw_on_screen::delete_layer_by_id(const std::string &id)
+{
+    return m_layers.delete_layer_by_id(id);
+}
+
+
+void Draw_on_screen::set_layer_cache_budget(size_t bytes)
+{
+    m_layers.set_budget(bytes);
+}
+
+
+Layer_cache &Draw_on_screen::return_layer_cache()
+{
+    return m_layers;
+}
+
+
+void Draw_on_screen::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    m_layers.set_frame_invalidation(frame_invalidation);
+    m_display_list.set_frame_invalidation(frame_invalidation);
+}
+
+
+void Draw_on_screen::set_threads_workers(ThreadsWorkers *threads_workers)
+{
+    m_framebuffer.set_threads_workers(threads_workers);
+}
+
+
+void Draw_on_screen::flush()
+{
+    prepare();
+    composite();
+    end_frame();
+}
+
+
+void Draw_on_screen::collect_damage(Damage_tracker &damage_tracker)
+{
+    // Couches et commandes retenues modifiées depuis la frame précédente
+    m_damage.clear();
+    m_layers.append_pending_damage(m_damage);
+    if (m_display_list.append_pending_damage(m_damage))
+        damage_tracker.add_full_damage();
+
+    for (const auto &rect : m_damage)
+        damage_tracker.add_damage(rect);
+
+    // Les primitives immédiates sont redessinées à chaque frame : leur zone actuelle et celle de la frame précédente
+    damage_tracker.add_damage(m_last_immediate_bounds);
+    if (!m_batch.return_bounds(m_last_immediate_bounds))
+        m_last_immediate_bounds = SDL_Rect{0, 0, 0, 0};
+
+    SDL_Rect text_bounds;
+    if (m_text.return_bounds(text_bounds))
     {
-        m_rect->x = x + i;
-        m_rect->y = y + i;
-        m_rect->w = width - 2 * i;
-        m_rect->h = height - 2 * i;
-        SDL_RenderDrawRect(m_renderer, m_rect);
+        if (m_last_immediate_bounds.w <= 0 || m_last_immediate_bounds.h <= 0)
+            m_last_immediate_bounds = text_bounds;
+        else
+            SDL_UnionRect(&m_last_immediate_bounds, &text_bounds, &m_last_immediate_bounds);
     }
+    damage_tracker.add_damage(m_last_immediate_bounds);
+
+    // En mode framebuffer les primitives ne passent pas par la file, la zone modifiée de l'image les couvre
+    SDL_Rect framebuffer_dirty;
+    if (m_framebuffer_mode && m_framebuffer.return_dirty_bounds(framebuffer_dirty))
+        damage_tracker.add_damage(framebuffer_dirty);
+}
+
+
+void Draw_on_screen::prepare()
+{
+    // Mise à jour des textures des couches et de la liste retenue, une seule fois par frame
+    m_layers.update();
+    m_display_list.update();
+    m_immediate_draw_calls = 0;
+
+    // Rastérisation des tuiles en parallèle puis un seul envoi de l'image par frame
+    if (m_framebuffer_mode && m_framebuffer.upload())
+        m_immediate_draw_calls++;
+}
+
+
+void Draw_on_screen::draw_background(const SDL_Rect *area)
+{
+    if (m_framebuffer_mode)
+        m_framebuffer.render();
+    else if (area)
+        SDL_RenderFillRect(m_renderer, area);
+    else
+        SDL_RenderClear(m_renderer);
+}
+
+
+void Draw_on_screen::composite()
+{
+    // Les couches puis la liste retenue sont copiées depuis leurs textures, les primitives immédiates passent par dessus
+    m_layers.composite();
+    m_display_list.composite();
+    m_batch.submit();
+    m_text.submit();
+    m_immediate_draw_calls += m_batch.return_last_draw_calls() + m_text.return_statistics().last_draw_calls;
+}
 
-    set_default_font_color();
+
+void Draw_on_screen::end_frame()
+{
+    m_batch.clear();
+    m_text.end_frame();
+    // Les primitives immédiates ne valent que pour une frame, comme la file
+    if (m_framebuffer_mode)
+        m_framebuffer.reset_drawn(m_background);
+}
+
+
+size_t Draw_on_screen::return_last_draw_calls() const
+{
+    return m_display_list.return_last_draw_calls() + m_immediate_draw_calls;
+}
+
+
+size_t Draw_on_screen::return_last_raster_tiles() const
+{
+    return m_framebuffer.return_last_tiles();
 }
 
 
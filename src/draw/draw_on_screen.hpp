@@ -10,6 +10,12 @@
 #include <algorithm>
 
 #include "../main_prog/data.hpp"
+#include "draw_batch.hpp"
+#include "display_list.hpp"
+#include "layer_cache.hpp"
+#include "text_renderer.hpp"
+#include "framebuffer.hpp"
+#include "../frame/damage_tracker.hpp"
 
 class Draw_on_screen {
 
@@ -18,6 +24,34 @@ private:
     SDL_Rect *m_rect;
     int *m_window_width, *m_window_height;
 
+    // Les primitives sont mises en file et envoyées au renderer en quelques appels par flush()
+    Draw_batch m_batch;
+
+    // Texte depuis l'atlas de glyphes, dessiné par dessus les primitives immédiates
+    Text_renderer m_text;
+
+    // Couches statiques mises en cache dans leurs textures, sous la liste retenue
+    Layer_cache m_layers;
+
+    // Commandes retenues d'une frame à l'autre, dessinées sous les primitives immédiates
+    Display_list m_display_list;
+
+    // En mode framebuffer les primitives immédiates sont dessinées en mémoire par nos noyaux SIMD
+    // L'image sert de fond à la place de SDL_RenderClear, elle est donc sous la liste retenue et les vidéos
+    Framebuffer m_framebuffer;
+    bool m_framebuffer_mode = false;
+    uint32_t m_background = 0xFFFFFFFF;
+    // Fond actuellement dans l'image, m_background peut changer en cours de frame
+    uint32_t m_framebuffer_background = 0xFFFFFFFF;
+
+    // Zone couverte par les primitives immédiates de la frame précédente, à effacer si elles ont bougé
+    SDL_Rect m_last_immediate_bounds{0, 0, 0, 0};
+    std::vector<SDL_Rect> m_damage;
+    size_t m_immediate_draw_calls = 0;
+
+private:
+    static int clamp_radius(int width, int height, int radius);
+
 public:
     Draw_on_screen() = delete;
     Draw_on_screen(SDL_Renderer *renderer, SDL_Rect *rect, int *w, int *h);
@@ -26,7 +60,60 @@ public:
     void set_color(Color color, int alpha = 255);
     void set_default_font_color();
 
+    void set_blend_mode(SDL_BlendMode blend_mode);
+    // Dessin logiciel des primitives immédiates, conseillé avec le renderer SOFTWARE
+    void set_framebuffer_mode(bool enabled);
+    [[nodiscard]] bool return_framebuffer_mode() const;
+    [[nodiscard]] Simd_level return_simd_level() const;
+
+    // Début de frame, à appeler avant les draw_* avec la taille de sortie du renderer
+    void begin_frame(int width, int height);
+
     void draw_rectangle(int x, int y, int width, int height, Color color, int alpha = 255, int radius = -1);
+    void draw_line(int x1, int y1, int x2, int y2, Color color, int alpha = 255);
+    void draw_point(int x, int y, Color color, int alpha = 255);
+    void draw_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, Color color, int alpha = 255);
+    void draw_circle(float center_x, float center_y, float radius, Color color, int alpha = 255);
+    void draw_rounded_rectangle(int x, int y, int width, int height, int corner_radius, Color color, int alpha = 255);
+    // Image ARGB8888 mise à l'échelle dans dst, pitch en pixels, uniquement en mode framebuffer
+    bool draw_image_scaled(const uint32_t *pixels, int width, int height, int pitch, SDL_Rect dst);
+
+    // Texte : la police 'id' est chargée une fois par taille, les glyphes sont rastérisés une seule fois
+    Handle load_font_by_id(const std::string &id, const std::string &path, int size);
+    bool draw_text(const std::string &font_id, const std::string &text, int x, int y, Color color, int alpha = 255);
+    bool draw_text(Handle font, const std::string &text, int x, int y, Color color, int alpha = 255);
+    Text_renderer& return_text_renderer();
+
+    // Version retenue de draw_rectangle : la commande 'id' reste affichée jusqu'à sa suppression
+    Handle set_rectangle_by_id(const std::string &id, int layer, int x, int y, int width, int height, Color color, int alpha = 255, int radius = -1);
+    Handle set_command_by_id(const std::string &id, const Draw_command &command);
+    bool delete_command_by_id(const std::string &id);
+    Display_list& return_display_list();
+
+    // Couche en cache : 'draw' n'est rappelée que si la couche est invalidée, sinon la couche coûte une copie par frame
+    Handle set_layer_by_id(const std::string &id, int z_order, SDL_Rect area, Layer_cache::Draw_function draw);
+    bool invalidate_layer_by_id(const std::string &id);
+    bool delete_layer_by_id(const std::string &id);
+    void set_layer_cache_budget(size_t bytes);
+    Layer_cache& return_layer_cache();
+
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+    // Pool qui rastérise les tuiles du framebuffer en parallèle
+    void set_threads_workers(ThreadsWorkers *threads_workers);
+
+    // Dessine la liste retenue puis les primitives en file, à appeler une fois par frame avant SDL_RenderPresent
+    void flush();
+
+    // Même chose découpé pour le rendu par zones : collect_damage, prepare, composite (une fois par zone) puis end_frame
+    void collect_damage(Damage_tracker &damage_tracker);
+    void prepare();
+    // Fond de la zone : le framebuffer s'il est actif, sinon la couleur de set_color
+    void draw_background(const SDL_Rect *area);
+    void composite();
+    void end_frame();
+    [[nodiscard]] size_t return_last_draw_calls() const;
+    // Tuiles rastérisées à la dernière frame en mode framebuffer
+    [[nodiscard]] size_t return_last_raster_tiles() const;
 };
 
 
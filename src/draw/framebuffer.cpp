@@ -0,0 +1,485 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "framebuffer.hpp"
+#include "../threads_workers/threads_workers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+
+Framebuffer::Framebuffer(SDL_Renderer *renderer, const Pixel_kernels &kernels) : m_renderer(renderer), m_kernels(&kernels)
+{
+}
+
+
+Framebuffer::~Framebuffer()
+{
+    if (m_texture)
+        SDL_DestroyTexture(m_texture);
+}
+
+
+uint32_t Framebuffer::to_argb(const SDL_Color &color)
+{
+    return (uint32_t(color.a) << 24) | (uint32_t(color.r) << 16) | (uint32_t(color.g) << 8) | uint32_t(color.b);
+}
+
+
+bool Framebuffer::resize(int width, int height, uint32_t background)
+{
+    if (m_texture && width == m_width && height == m_height)
+        return true;
+
+    if (m_texture)
+        SDL_DestroyTexture(m_texture);
+
+    m_texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+    if (!m_texture)
+    {
+        std::cout << "Framebuffer texture could not be created : " << SDL_GetError() << std::endl;
+        m_width = m_height = 0;
+        m_pixels.clear();
+        return false;
+    }
+
+    // L'image est opaque, elle remplace SDL_RenderClear
+    SDL_SetTextureBlendMode(m_texture, SDL_BLENDMODE_NONE);
+    m_width = width;
+    m_height = height;
+    m_pixels.assign(size_t(width) * size_t(height), background);
+    m_commands.clear();
+    m_dirty = SDL_Rect{0, 0, width, height};
+    m_drawn = SDL_Rect{0, 0, 0, 0};
+    return true;
+}
+
+
+void Framebuffer::clear(uint32_t color)
+{
+    m_commands.clear();
+    m_kernels->fill_span(m_pixels.data(), m_pixels.size(), color | 0xFF000000u);
+    m_dirty = SDL_Rect{0, 0, m_width, m_height};
+    m_drawn = SDL_Rect{0, 0, 0, 0};
+}
+
+
+void Framebuffer::extend(SDL_Rect &bounds, const SDL_Rect &rect)
+{
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+
+    if (bounds.w <= 0 || bounds.h <= 0)
+    {
+        bounds = rect;
+        return;
+    }
+
+    int x = std::min(bounds.x, rect.x), y = std::min(bounds.y, rect.y);
+    bounds = SDL_Rect{x, y, std::max(bounds.x + bounds.w, rect.x + rect.w) - x, std::max(bounds.y + bounds.h, rect.y + rect.h) - y};
+}
+
+
+bool Framebuffer::clip(SDL_Rect &rect, const SDL_Rect &area)
+{
+    // Limite le rectangle à la zone, renvoie false s'il n'en reste rien
+    int x = std::max(rect.x, area.x), y = std::max(rect.y, area.y);
+    int right = std::min(rect.x + rect.w, area.x + area.w), bottom = std::min(rect.y + rect.h, area.y + area.h);
+    rect = SDL_Rect{x, y, right - x, bottom - y};
+    return rect.w > 0 && rect.h > 0;
+}
+
+
+void Framebuffer::span(const Raster_target &target, int x, int y, int width, uint32_t color)
+{
+    // Une ligne horizontale, déjà dans la zone : remplissage si opaque, mélange sinon
+    uint32_t *row = &target.pixels[size_t(y) * size_t(target.width) + size_t(x)];
+    if ((color >> 24) == 0xFF)
+        target.kernels->fill_span(row, size_t(width), color);
+    else if ((color >> 24) != 0)
+        target.kernels->blend_span(row, size_t(width), color);
+}
+
+
+void Framebuffer::record(Raster_command command)
+{
+    // Rien n'est dessiné ici : on garde la commande et sa zone pour le découpage en tuiles
+    if (!clip(command.bounds, SDL_Rect{0, 0, m_width, m_height}))
+        return;
+
+    extend(m_dirty, command.bounds);
+    extend(m_drawn, command.bounds);
+    m_commands.push_back(command);
+}
+
+
+void Framebuffer::fill_rect(SDL_Rect rect, uint32_t color)
+{
+    Raster_command command{};
+    command.kind = Raster_kind::FILL_RECT;
+    command.color = color;
+    command.rect = rect;
+    command.bounds = rect;
+    record(command);
+}
+
+
+void Framebuffer::draw_rect_outline(const SDL_Rect &rect, int thickness, uint32_t color)
+{
+    // 4 bandes qui ne se recouvrent pas, un contour transparent n'est donc mélangé qu'une fois
+    if (thickness <= 0 || rect.w <= 0 || rect.h <= 0)
+        return;
+
+    if (thickness * 2 >= rect.w || thickness * 2 >= rect.h)
+    {
+        fill_rect(rect, color);
+        return;
+    }
+
+    fill_rect({rect.x, rect.y, rect.w, thickness}, color);
+    fill_rect({rect.x, rect.y + rect.h - thickness, rect.w, thickness}, color);
+    fill_rect({rect.x, rect.y + thickness, thickness, rect.h - 2 * thickness}, color);
+    fill_rect({rect.x + rect.w - thickness, rect.y + thickness, thickness, rect.h - 2 * thickness}, color);
+}
+
+
+void Framebuffer::fill_rounded_rect(const SDL_Rect &rect, int radius, uint32_t color)
+{
+    Raster_command command{};
+    command.kind = Raster_kind::ROUNDED_RECT;
+    command.color = color;
+    command.rect = rect;
+    command.bounds = rect;
+    command.radius = std::clamp(radius, 0, std::min(rect.w, rect.h) / 2);
+    record(command);
+}
+
+
+void Framebuffer::fill_circle(int center_x, int center_y, int radius, uint32_t color)
+{
+    fill_rounded_rect({center_x - radius, center_y - radius, radius * 2, radius * 2}, radius, color);
+}
+
+
+void Framebuffer::fill_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, uint32_t color)
+{
+    // Sommets triés par y une fois pour toutes, chaque tuile refait le même balayage
+    if (a.y > b.y) std::swap(a, b);
+    if (b.y > c.y) std::swap(b, c);
+    if (a.y > b.y) std::swap(a, b);
+
+    if (c.y - a.y <= 0.0f)
+        return;
+
+    int left = int(std::floor(std::min({a.x, b.x, c.x})));
+    int right = int(std::ceil(std::max({a.x, b.x, c.x})));
+    int top = int(std::ceil(a.y - 0.5f));
+    int bottom = int(std::ceil(c.y - 0.5f));
+
+    Raster_command command{};
+    command.kind = Raster_kind::TRIANGLE;
+    command.color = color;
+    command.bounds = SDL_Rect{left, top, right - left + 1, bottom - top};
+    command.points[0] = a;
+    command.points[1] = b;
+    command.points[2] = c;
+    record(command);
+}
+
+
+void Framebuffer::draw_line(int x1, int y1, int x2, int y2, uint32_t color)
+{
+    // Les lignes horizontales et verticales sont des spans
+    if (x1 == x2 || y1 == y2)
+    {
+        fill_rect({std::min(x1, x2), std::min(y1, y2), std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1}, color);
+        return;
+    }
+
+    Raster_command command{};
+    command.kind = Raster_kind::LINE;
+    command.color = color;
+    command.rect = SDL_Rect{x1, y1, x2, y2};
+    command.bounds = SDL_Rect{std::min(x1, x2), std::min(y1, y2), std::abs(x2 - x1) + 1, std::abs(y2 - y1) + 1};
+    record(command);
+}
+
+
+void Framebuffer::draw_point(int x, int y, uint32_t color)
+{
+    fill_rect({x, y, 1, 1}, color);
+}
+
+
+void Framebuffer::blit_scaled(const uint32_t *src, int src_width, int src_height, int src_pitch, SDL_Rect dst)
+{
+    if (!src || src_width <= 0 || src_height <= 0 || dst.w <= 0 || dst.h <= 0)
+        return;
+
+    Raster_command command{};
+    command.kind = Raster_kind::BLIT;
+    command.rect = dst;
+    command.bounds = dst;
+    command.src = src;
+    command.src_width = src_width;
+    command.src_height = src_height;
+    command.src_pitch = src_pitch;
+    record(command);
+}
+
+
+void Framebuffer::execute(const Raster_target &target, const Raster_command &command)
+{
+    // Toutes les écritures sont limitées à target.clip : deux tuiles ne touchent jamais les mêmes pixels
+    SDL_Rect visible = command.bounds;
+    if (!clip(visible, target.clip))
+        return;
+
+    switch (command.kind)
+    {
+        case Raster_kind::FILL_RECT:
+            for (int y = visible.y; y < visible.y + visible.h; y++)
+                span(target, visible.x, y, visible.w, command.color);
+            break;
+
+        case Raster_kind::ROUNDED_RECT:
+        {
+            // Chaque ligne est un seul span, rentré dans les coins selon le cercle de rayon radius
+            const SDL_Rect &rect = command.rect;
+            const int radius = command.radius;
+            for (int y = visible.y; y < visible.y + visible.h; y++)
+            {
+                int row = y - rect.y;
+                float dy = -1.0f;
+                if (row < radius)
+                    dy = float(radius - row) - 0.5f;
+                else if (row >= rect.h - radius)
+                    dy = float(row - (rect.h - radius)) + 0.5f;
+
+                int inset = 0;
+                if (dy >= 0.0f)
+                    inset = int(float(radius) - std::sqrt(std::max(0.0f, float(radius * radius) - dy * dy)) + 0.5f);
+
+                int left = std::max(rect.x + inset, visible.x);
+                int right = std::min(rect.x + rect.w - inset, visible.x + visible.w);
+                if (right > left)
+                    span(target, left, y, right - left, command.color);
+            }
+            break;
+        }
+
+        case Raster_kind::TRIANGLE:
+        {
+            // Balayage par lignes : pour chaque centre de pixel, les deux bords actifs donnent un span
+            const SDL_FPoint &a = command.points[0], &b = command.points[1], &c = command.points[2];
+            auto edge_x = [](const SDL_FPoint &from, const SDL_FPoint &to, float y) {
+                return from.x + (to.x - from.x) * (y - from.y) / (to.y - from.y);
+            };
+
+            for (int y = visible.y; y < visible.y + visible.h; y++)
+            {
+                float center = float(y) + 0.5f;
+                float long_x = edge_x(a, c, center);
+                float short_x = center < b.y ? (b.y > a.y ? edge_x(a, b, center) : a.x) : (c.y > b.y ? edge_x(b, c, center) : c.x);
+
+                int left = std::max(int(std::ceil(std::min(long_x, short_x) - 0.5f)), visible.x);
+                int right = std::min(int(std::ceil(std::max(long_x, short_x) - 0.5f)), visible.x + visible.w);
+                if (right > left)
+                    span(target, left, y, right - left, command.color);
+            }
+            break;
+        }
+
+        case Raster_kind::LINE:
+        {
+            // Bresenham, un pixel à la fois : chaque tuile parcourt toute la ligne pour garder exactement les mêmes pixels
+            int x1 = command.rect.x, y1 = command.rect.y, x2 = command.rect.w, y2 = command.rect.h;
+            int dx = std::abs(x2 - x1), dy = -std::abs(y2 - y1);
+            int step_x = x1 < x2 ? 1 : -1, step_y = y1 < y2 ? 1 : -1;
+            int error = dx + dy;
+            int x = x1, y = y1;
+            while (true)
+            {
+                if (x >= visible.x && x < visible.x + visible.w && y >= visible.y && y < visible.y + visible.h)
+                    span(target, x, y, 1, command.color);
+
+                if (x == x2 && y == y2)
+                    break;
+
+                int error_2 = 2 * error;
+                if (error_2 >= dy) { error += dy; x += step_x; }
+                if (error_2 <= dx) { error += dx; y += step_y; }
+            }
+            break;
+        }
+
+        case Raster_kind::BLIT:
+        {
+            // Pas en virgule fixe 16.16, on échantillonne au centre de chaque pixel de destination
+            const SDL_Rect &dst = command.rect;
+            uint32_t x_step = uint32_t((uint64_t(command.src_width) << 16) / uint64_t(dst.w));
+            uint32_t x_start = (x_step >> 1) + uint32_t(visible.x - dst.x) * x_step;
+
+            for (int y = visible.y; y < visible.y + visible.h; y++)
+            {
+                int src_y = int((int64_t(y - dst.y) * 2 + 1) * command.src_height / (int64_t(dst.h) * 2));
+                const uint32_t *src_row = command.src + size_t(src_y) * size_t(command.src_pitch);
+                target.kernels->blit_span_scaled(&target.pixels[size_t(y) * size_t(target.width) + size_t(visible.x)], size_t(visible.w), src_row, x_start, x_step);
+            }
+            break;
+        }
+    }
+}
+
+
+void Framebuffer::bin_commands(int columns, int rows)
+{
+    // Deux passes sur les commandes : on compte par tuile, puis on range les indices à leur place
+    // Les indices sont rangés dans l'ordre croissant, chaque tuile garde donc l'ordre d'appel
+    const size_t tiles_count = size_t(columns) * size_t(rows);
+    m_tile_offsets.assign(tiles_count + 1, 0);
+
+    auto for_each_tile = [this, columns](const Raster_command &command, auto &&function) {
+        int first_column = command.bounds.x / m_tile_size, last_column = (command.bounds.x + command.bounds.w - 1) / m_tile_size;
+        int first_row = command.bounds.y / m_tile_size, last_row = (command.bounds.y + command.bounds.h - 1) / m_tile_size;
+        for (int row = first_row; row <= last_row; row++)
+            for (int column = first_column; column <= last_column; column++)
+                function(size_t(row) * size_t(columns) + size_t(column));
+    };
+
+    for (const auto &command : m_commands)
+        for_each_tile(command, [this](size_t tile) { m_tile_offsets[tile + 1]++; });
+
+    for (size_t tile = 0; tile < tiles_count; tile++)
+        m_tile_offsets[tile + 1] += m_tile_offsets[tile];
+
+    m_tile_commands.resize(m_tile_offsets[tiles_count]);
+    std::vector<uint32_t> &cursor = m_active_tiles;
+    cursor.assign(m_tile_offsets.begin(), m_tile_offsets.end() - 1);
+    for (uint32_t index = 0; index < uint32_t(m_commands.size()); index++)
+        for_each_tile(m_commands[index], [this, &cursor, index](size_t tile) { m_tile_commands[cursor[tile]++] = index; });
+
+    // Seules les tuiles qui ont au moins une commande sont rastérisées
+    m_active_tiles.clear();
+    for (uint32_t tile = 0; tile < uint32_t(tiles_count); tile++)
+    {
+        if (m_tile_offsets[tile + 1] > m_tile_offsets[tile])
+            m_active_tiles.push_back(tile);
+    }
+}
+
+
+void Framebuffer::rasterize()
+{
+    m_last_commands = m_commands.size();
+    m_last_tiles = 0;
+    if (m_commands.empty())
+        return;
+
+    const int columns = (m_width + m_tile_size - 1) / m_tile_size;
+    const int rows = (m_height + m_tile_size - 1) / m_tile_size;
+    bin_commands(columns, rows);
+    m_last_tiles = m_active_tiles.size();
+
+    auto rasterize_tile = [this, columns](size_t active_index) {
+        uint32_t tile = m_active_tiles[active_index];
+        int column = int(tile % uint32_t(columns)), row = int(tile / uint32_t(columns));
+
+        Raster_target target{m_pixels.data(), m_width, SDL_Rect{column * m_tile_size, row * m_tile_size, m_tile_size, m_tile_size}, m_kernels};
+        clip(target.clip, SDL_Rect{0, 0, m_width, m_height});
+
+        for (uint32_t i = m_tile_offsets[tile]; i < m_tile_offsets[tile + 1]; i++)
+            execute(target, m_commands[m_tile_commands[i]]);
+    };
+
+    // Les tuiles ne partagent aucun pixel : elles sont rastérisées dans n'importe quel ordre, directement dans l'image finale
+    if (m_threads_workers && m_active_tiles.size() > 1)
+        m_threads_workers->parallel_for(m_active_tiles.size(), rasterize_tile);
+    else
+        for (size_t i = 0; i < m_active_tiles.size(); i++)
+            rasterize_tile(i);
+
+    m_commands.clear();
+}
+
+
+void Framebuffer::set_threads_workers(ThreadsWorkers *threads_workers)
+{
+    m_threads_workers = threads_workers;
+}
+
+
+void Framebuffer::reset_drawn(uint32_t background)
+{
+    // Ce qui n'a pas encore été rastérisé serait effacé de toute façon
+    m_commands.clear();
+
+    SDL_Rect drawn = m_drawn;
+    for (int y = drawn.y; y < drawn.y + drawn.h; y++)
+        m_kernels->fill_span(&m_pixels[size_t(y) * size_t(m_width) + size_t(drawn.x)], size_t(drawn.w), background | 0xFF000000u);
+
+    extend(m_dirty, drawn);
+    m_drawn = SDL_Rect{0, 0, 0, 0};
+}
+
+
+bool Framebuffer::upload()
+{
+    rasterize();
+
+    // Un seul envoi par frame, limité à la zone modifiée
+    if (!m_texture || m_dirty.w <= 0 || m_dirty.h <= 0)
+        return false;
+
+    SDL_UpdateTexture(m_texture, &m_dirty, &m_pixels[size_t(m_dirty.y) * size_t(m_width) + size_t(m_dirty.x)], m_width * int(sizeof(uint32_t)));
+    m_dirty = SDL_Rect{0, 0, 0, 0};
+    return true;
+}
+
+
+void Framebuffer::render() const
+{
+    if (m_texture)
+        SDL_RenderCopy(m_renderer, m_texture, nullptr, nullptr);
+}
+
+
+bool Framebuffer::return_dirty_bounds(SDL_Rect &bounds) const
+{
+    bounds = m_dirty;
+    return m_dirty.w > 0 && m_dirty.h > 0;
+}
+
+uint32_t *Framebuffer::return_pixels()
+{
+    rasterize();
+    return m_pixels.data();
+}
+
+int Framebuffer::return_width() const
+{
+    return m_width;
+}
+
+int Framebuffer::return_height() const
+{
+    return m_height;
+}
+
+Simd_level Framebuffer::return_simd_level() const
+{
+    return m_kernels->level;
+}
+
+size_t Framebuffer::return_last_tiles() const
+{
+    return m_last_tiles;
+}
+
+size_t Framebuffer::return_last_commands() const
+{
+    return m_last_commands;
+}
@@ -0,0 +1,139 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_FRAMEBUFFER_HPP
+#define MEINCANVAS_FRAMEBUFFER_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "pixel_kernels.hpp"
+
+class ThreadsWorkers;
+
+
+// Image ARGB8888 en mémoire dessinée par nos propres noyaux SIMD au lieu des chemins génériques de SDL
+// Tout le dessin se fait en mémoire, l'image n'est envoyée à sa texture qu'une fois par frame par upload()
+// L'image est opaque : elle sert de fond, les couleurs avec alpha sont mélangées au pixel déjà présent
+// Les primitives sont enregistrées puis rastérisées par tuiles de l'écran, en parallèle si un pool est fourni
+class Framebuffer {
+private:
+    // Une primitive enregistrée, rastérisée plus tard tuile par tuile
+    enum class Raster_kind
+    {
+        FILL_RECT,
+        ROUNDED_RECT,
+        TRIANGLE,
+        LINE,
+        BLIT
+    };
+
+    struct Raster_command
+    {
+        Raster_kind kind;
+        uint32_t color;
+        // Zone touchée, déjà limitée à l'image, sert au découpage en tuiles
+        SDL_Rect bounds;
+        // Rectangle complet (FILL_RECT, ROUNDED_RECT, BLIT), ou extrémités de la ligne dans x, y, w, h
+        SDL_Rect rect;
+        int radius;
+        SDL_FPoint points[3];
+        const uint32_t *src;
+        int src_width, src_height, src_pitch;
+    };
+
+    // Zone d'une tuile dans l'image, toutes les écritures y sont limitées
+    struct Raster_target
+    {
+        uint32_t *pixels;
+        int width;
+        SDL_Rect clip;
+        const Pixel_kernels *kernels;
+    };
+
+    // Taille des tuiles en pixels, un multiple de 8 pour les noyaux AVX2
+    static constexpr int m_tile_size = 128;
+
+    SDL_Renderer *m_renderer;
+    SDL_Texture *m_texture = nullptr;
+    const Pixel_kernels *m_kernels;
+    ThreadsWorkers *m_threads_workers = nullptr;
+
+    std::vector<uint32_t> m_pixels;
+    int m_width = 0;
+    int m_height = 0;
+
+    // Primitives de la frame dans l'ordre d'appel, l'ordre est conservé dans chaque tuile
+    std::vector<Raster_command> m_commands;
+    // Indices des commandes par tuile, rangés à la suite : tuile t = m_tile_commands[m_tile_offsets[t] .. m_tile_offsets[t + 1][
+    std::vector<uint32_t> m_tile_offsets;
+    std::vector<uint32_t> m_tile_commands;
+    std::vector<uint32_t> m_active_tiles;
+    size_t m_last_tiles = 0;
+    size_t m_last_commands = 0;
+
+    // Zone modifiée depuis le dernier upload(), seule elle est envoyée à la texture
+    SDL_Rect m_dirty{0, 0, 0, 0};
+    // Zone dessinée depuis le dernier reset_drawn(), à remettre au fond à la frame suivante
+    SDL_Rect m_drawn{0, 0, 0, 0};
+
+private:
+    static void extend(SDL_Rect &bounds, const SDL_Rect &rect);
+    static bool clip(SDL_Rect &rect, const SDL_Rect &area);
+    static void span(const Raster_target &target, int x, int y, int width, uint32_t color);
+    static void execute(const Raster_target &target, const Raster_command &command);
+    void record(Raster_command command);
+    void bin_commands(int columns, int rows);
+
+public:
+    Framebuffer() = delete;
+    explicit Framebuffer(SDL_Renderer *renderer, const Pixel_kernels &kernels = return_pixel_kernels());
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    ~Framebuffer();
+
+    // Recrée l'image et sa texture si la taille change, renvoie false si la texture n'a pas pu être créée
+    bool resize(int width, int height, uint32_t background);
+    void clear(uint32_t color);
+
+    void fill_rect(SDL_Rect rect, uint32_t color);
+    void draw_rect_outline(const SDL_Rect &rect, int thickness, uint32_t color);
+    void fill_rounded_rect(const SDL_Rect &rect, int radius, uint32_t color);
+    void fill_circle(int center_x, int center_y, int radius, uint32_t color);
+    void fill_triangle(SDL_FPoint a, SDL_FPoint b, SDL_FPoint c, uint32_t color);
+    void draw_line(int x1, int y1, int x2, int y2, uint32_t color);
+    void draw_point(int x, int y, uint32_t color);
+    // Copie mise à l'échelle (plus proche voisin) d'une image ARGB8888, pitch en pixels
+    // L'image source doit rester valide jusqu'au prochain rasterize() (au plus tard upload())
+    void blit_scaled(const uint32_t *src, int src_width, int src_height, int src_pitch, SDL_Rect dst);
+
+    // Pool utilisé pour rastériser les tuiles, nullptr pour tout faire sur le thread appelant
+    void set_threads_workers(ThreadsWorkers *threads_workers);
+    // Rastérise les primitives enregistrées : chaque tuile exécute ses commandes dans l'ordre d'appel
+    void rasterize();
+
+    // Remet au fond tout ce qui a été dessiné depuis le dernier appel
+    void reset_drawn(uint32_t background);
+
+    // Rastérise puis envoie la zone modifiée à la texture en un seul SDL_UpdateTexture
+    bool upload();
+    // Copie la texture sur la cible courante du renderer (limitée par son clip)
+    void render() const;
+
+    [[nodiscard]] bool return_dirty_bounds(SDL_Rect &bounds) const;
+    [[nodiscard]] uint32_t *return_pixels();
+    [[nodiscard]] int return_width() const;
+    [[nodiscard]] int return_height() const;
+    [[nodiscard]] Simd_level return_simd_level() const;
+    // Tuiles et commandes traitées par le dernier rasterize()
+    [[nodiscard]] size_t return_last_tiles() const;
+    [[nodiscard]] size_t return_last_commands() const;
+
+    static uint32_t to_argb(const SDL_Color &color);
+};
+
+
+#endif //MEINCANVAS_FRAMEBUFFER_HPP
@@ -0,0 +1,447 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "layer_cache.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <tuple>
+
+
+Layer_cache::Layer_cache(SDL_Renderer *renderer) : m_renderer(renderer), m_batch(renderer)
+{
+}
+
+
+Layer_cache::~Layer_cache()
+{
+    m_layers.for_each([](Handle, Layer &layer) {
+        if (layer.texture)
+            SDL_DestroyTexture(layer.texture);
+    });
+
+    for (SDL_Texture *texture : m_retired_textures)
+        SDL_DestroyTexture(texture);
+}
+
+
+void Layer_cache::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    m_frame_invalidation = frame_invalidation;
+}
+
+
+void Layer_cache::set_budget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_budget_bytes = bytes;
+}
+
+
+size_t Layer_cache::texture_bytes(int width, int height)
+{
+    // ARGB8888, sans compter ce que le pilote ajoute
+    return size_t(std::max(width, 0)) * size_t(std::max(height, 0)) * 4;
+}
+
+
+void Layer_cache::add_damage(const SDL_Rect &rect)
+{
+    if (rect.w > 0 && rect.h > 0)
+        m_damage.push_back(rect);
+}
+
+
+void Layer_cache::signal_change()
+{
+    // La frame doit être redessinée (mode de rendu à la demande)
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+}
+
+
+void Layer_cache::release_texture(Layer &layer)
+{
+    // La texture est détruite plus tard sur le thread de rendu, la couche devra être redessinée
+    if (!layer.texture)
+        return;
+
+    m_retired_textures.push_back(layer.texture);
+    m_cache_bytes -= texture_bytes(layer.texture_width, layer.texture_height);
+    layer.texture = nullptr;
+    layer.texture_width = 0;
+    layer.texture_height = 0;
+    layer.dirty = true;
+}
+
+
+Handle Layer_cache::set_layer(const std::string &id, int z_order, SDL_Rect area, Draw_function draw)
+{
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        handle = m_layers.find(id);
+        if (Layer *layer = m_layers.get(handle))
+        {
+            // Nouvelle fonction de dessin : on garde la texture si la taille ne change pas, mais on la redessine
+            add_damage(layer->area);
+            if (layer->z_order != z_order)
+                m_sort_dirty = true;
+            layer->z_order = z_order;
+            layer->area = area;
+            layer->draw = std::move(draw);
+            layer->dirty = true;
+        }
+        else
+        {
+            handle = m_layers.insert(Layer{z_order, m_next_order++, area, true, std::move(draw)}, id);
+            m_sort_dirty = true;
+        }
+        add_damage(area);
+    }
+
+    signal_change();
+    return handle;
+}
+
+
+bool Layer_cache::invalidate_layer(Handle handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Layer *layer = m_layers.get(handle);
+        if (!layer)
+            return false;
+
+        layer->dirty = true;
+        if (layer->visible)
+            add_damage(layer->area);
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Layer_cache::invalidate_layer_by_id(const std::string &id)
+{
+    return invalidate_layer(return_layer_handle(id));
+}
+
+
+bool Layer_cache::set_layer_area(Handle handle, SDL_Rect area)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Layer *layer = m_layers.get(handle);
+        if (!layer)
+            return false;
+
+        if (layer->area.x == area.x && layer->area.y == area.y && layer->area.w == area.w && layer->area.h == area.h)
+            return true;
+
+        if (layer->visible)
+        {
+            add_damage(layer->area);
+            add_damage(area);
+        }
+        layer->area = area;
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Layer_cache::set_layer_z_order(Handle handle, int z_order)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Layer *layer = m_layers.get(handle);
+        if (!layer)
+            return false;
+
+        if (layer->z_order == z_order)
+            return true;
+
+        layer->z_order = z_order;
+        m_sort_dirty = true;
+        if (layer->visible)
+            add_damage(layer->area);
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Layer_cache::set_layer_visible(Handle handle, bool visible)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Layer *layer = m_layers.get(handle);
+        if (!layer)
+            return false;
+
+        if (layer->visible == visible)
+            return true;
+
+        // Une couche cachée garde sa texture tant que le budget le permet, la réafficher ne coûte qu'une copie
+        layer->visible = visible;
+        add_damage(layer->area);
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Layer_cache::delete_layer(Handle handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        Layer *layer = m_layers.get(handle);
+        if (!layer)
+            return false;
+
+        if (layer->visible)
+            add_damage(layer->area);
+        release_texture(*layer);
+        m_layers.erase(handle);
+        m_sort_dirty = true;
+    }
+
+    signal_change();
+    return true;
+}
+
+
+bool Layer_cache::delete_layer_by_id(const std::string &id)
+{
+    return delete_layer(return_layer_handle(id));
+}
+
+
+Handle Layer_cache::return_layer_handle(const std::string &id) const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_layers.find(id);
+}
+
+
+void Layer_cache::clear()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_layers.for_each([this](Handle, Layer &layer) {
+            if (layer.visible)
+                add_damage(layer.area);
+            release_texture(layer);
+        });
+        m_layers.clear();
+        m_z_sorted.clear();
+        m_sort_dirty = false;
+    }
+
+    signal_change();
+}
+
+
+void Layer_cache::sort_layers()
+{
+    m_z_sorted.clear();
+    m_z_sorted.reserve(m_layers.size());
+    m_layers.for_each([this](Handle handle, Layer &) {
+        m_z_sorted.push_back(handle);
+    });
+
+    std::sort(m_z_sorted.begin(), m_z_sorted.end(), [this](Handle a, Handle b) {
+        const Layer *layer_a = m_layers.get(a), *layer_b = m_layers.get(b);
+        return std::tie(layer_a->z_order, layer_a->order) < std::tie(layer_b->z_order, layer_b->order);
+    });
+    m_sort_dirty = false;
+}
+
+
+bool Layer_cache::evict_least_recently_used()
+{
+    // On ne libère jamais une couche déjà utilisée par la frame en cours
+    Layer *oldest = nullptr;
+    m_layers.for_each([this, &oldest](Handle, Layer &layer) {
+        if (layer.texture && layer.last_used < m_frame && (!oldest || layer.last_used < oldest->last_used))
+            oldest = &layer;
+    });
+
+    if (!oldest)
+        return false;
+
+    release_texture(*oldest);
+    m_statistics.last_evicted++;
+    m_statistics.total_evicted++;
+    return true;
+}
+
+
+void Layer_cache::rasterize(Layer &layer)
+{
+    // La couche est dessinée dans sa texture sur fond transparent, les couches et vidéos dessous restent visibles
+    SDL_Texture *previous_target = SDL_GetRenderTarget(m_renderer);
+    SDL_SetRenderTarget(m_renderer, layer.texture);
+
+    Uint8 r, g, b, a;
+    SDL_BlendMode previous_blend_mode;
+    SDL_GetRenderDrawColor(m_renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(m_renderer, &previous_blend_mode);
+    SDL_SetRenderDrawColor(m_renderer, 0, 0, 0, 0);
+    SDL_SetRenderDrawBlendMode(m_renderer, SDL_BLENDMODE_NONE);
+    SDL_RenderClear(m_renderer);
+    SDL_SetRenderDrawColor(m_renderer, r, g, b, a);
+    SDL_SetRenderDrawBlendMode(m_renderer, previous_blend_mode);
+
+    if (layer.draw)
+        layer.draw(m_batch);
+    m_batch.flush();
+
+    SDL_SetRenderTarget(m_renderer, previous_target);
+    layer.dirty = false;
+}
+
+
+void Layer_cache::draw_direct(const Layer &layer)
+{
+    // Sans texture, la couche est dessinée à sa place par le viewport
+    // Le clip du renderer est relatif au viewport, on le décale le temps du dessin
+    SDL_Rect clip{0, 0, 0, 0};
+    bool clip_enabled = SDL_RenderIsClipEnabled(m_renderer) == SDL_TRUE;
+    if (clip_enabled)
+        SDL_RenderGetClipRect(m_renderer, &clip);
+
+    SDL_RenderSetViewport(m_renderer, &layer.area);
+    if (clip_enabled)
+    {
+        SDL_Rect local_clip{clip.x - layer.area.x, clip.y - layer.area.y, clip.w, clip.h};
+        SDL_RenderSetClipRect(m_renderer, &local_clip);
+    }
+
+    if (layer.draw)
+        layer.draw(m_batch);
+    m_batch.flush();
+
+    SDL_RenderSetViewport(m_renderer, nullptr);
+    SDL_RenderSetClipRect(m_renderer, clip_enabled ? &clip : nullptr);
+}
+
+
+void Layer_cache::update()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_frame++;
+    m_statistics.last_rasterized = 0;
+    m_statistics.last_uncached = 0;
+    m_statistics.last_evicted = 0;
+
+    for (SDL_Texture *texture : m_retired_textures)
+        SDL_DestroyTexture(texture);
+    m_retired_textures.clear();
+
+    if (m_sort_dirty)
+        sort_layers();
+
+    // Les couches visibles sont marquées d'abord, l'éviction ne touche donc que les couches inutilisées
+    for (Handle handle : m_z_sorted)
+    {
+        Layer *layer = m_layers.get(handle);
+        if (!layer || !layer->visible || layer->area.w <= 0 || layer->area.h <= 0)
+            continue;
+
+        layer->last_used = m_frame;
+        layer->uncached = false;
+        if (layer->texture && (layer->texture_width != layer->area.w || layer->texture_height != layer->area.h))
+            release_texture(*layer);
+    }
+
+    // Budget dépassé (budget réduit ou couches agrandies) : on libère d'abord les couches inutilisées
+    while (m_cache_bytes > m_budget_bytes && evict_least_recently_used());
+
+    for (Handle handle : m_z_sorted)
+    {
+        Layer *layer = m_layers.get(handle);
+        if (!layer || layer->last_used != m_frame)
+            continue;
+
+        if (!layer->texture)
+        {
+            size_t bytes = texture_bytes(layer->area.w, layer->area.h);
+            while (m_cache_bytes + bytes > m_budget_bytes && evict_least_recently_used());
+
+            if (m_cache_bytes + bytes <= m_budget_bytes)
+            {
+                layer->texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, layer->area.w, layer->area.h);
+                if (!layer->texture)
+                    std::cout << "Layer texture could not be created : " << SDL_GetError() << std::endl;
+            }
+
+            if (!layer->texture)
+            {
+                layer->uncached = true;
+                m_statistics.last_uncached++;
+                continue;
+            }
+
+            SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND);
+            layer->texture_width = layer->area.w;
+            layer->texture_height = layer->area.h;
+            layer->dirty = true;
+            m_cache_bytes += bytes;
+        }
+
+        if (layer->dirty)
+        {
+            rasterize(*layer);
+            m_statistics.last_rasterized++;
+            m_statistics.total_rasterized++;
+        }
+    }
+}
+
+
+void Layer_cache::composite()
+{
+    // Une copie par couche visible, de la plus basse à la plus haute
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (Handle handle : m_z_sorted)
+    {
+        const Layer *layer = m_layers.get(handle);
+        if (!layer || layer->last_used != m_frame)
+            continue;
+
+        if (layer->texture && !layer->dirty)
+            SDL_RenderCopy(m_renderer, layer->texture, nullptr, &layer->area);
+        else if (layer->uncached)
+            draw_direct(*layer);
+    }
+}
+
+
+void Layer_cache::append_pending_damage(std::vector<SDL_Rect> &rects)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    rects.insert(rects.end(), m_damage.begin(), m_damage.end());
+    m_damage.clear();
+}
+
+
+Layer_statistics Layer_cache::return_statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Layer_statistics statistics = m_statistics;
+    statistics.layers = m_layers.size();
+    statistics.cache_bytes = m_cache_bytes;
+    statistics.budget_bytes = m_budget_bytes;
+    m_layers.for_each([&statistics](Handle, const Layer &layer) {
+        if (layer.texture)
+            statistics.cached_layers++;
+    });
+    return statistics;
+}
@@ -0,0 +1,133 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_LAYER_CACHE_HPP
+#define MEINCANVAS_LAYER_CACHE_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "draw_batch.hpp"
+#include "../frame/frame_invalidation.hpp"
+#include "../registry/registry.hpp"
+
+
+struct Layer_statistics
+{
+    size_t layers = 0;
+    size_t cached_layers = 0;       // Couches qui ont une texture
+    size_t cache_bytes = 0;         // Mémoire des textures, estimée à 4 octets par pixel
+    size_t budget_bytes = 0;
+
+    // Dernière frame
+    size_t last_rasterized = 0;     // Couches redessinées dans leur texture
+    size_t last_uncached = 0;       // Couches visibles sans place dans le budget, dessinées directement
+    size_t last_evicted = 0;
+
+    uint64_t total_rasterized = 0;
+    uint64_t total_evicted = 0;
+};
+
+
+// Couches hors écran : chaque couche est dessinée par sa fonction dans sa propre texture, puis copiée
+// en un seul appel à chaque frame, dans l'ordre de z_order
+// La fonction n'est rappelée que si la couche est invalidée, change de taille ou a perdu sa texture
+// Les textures respectent un budget mémoire : on libère d'abord celles qui n'ont pas servi depuis le plus longtemps
+class Layer_cache {
+public:
+    // Dessine la couche en coordonnées locales : (0, 0) est le coin haut gauche de sa zone
+    // Appelée sur le thread de rendu, elle ne doit pas appeler les fonctions de Layer_cache
+    using Draw_function = std::function<void(Draw_batch &batch)>;
+
+private:
+    struct Layer {
+        int z_order;
+        uint64_t order;
+        SDL_Rect area;
+        bool visible;
+        Draw_function draw;
+
+        SDL_Texture *texture = nullptr;
+        int texture_width = 0;
+        int texture_height = 0;
+        bool dirty = true;
+        // Numéro de la dernière frame où la couche était visible, pour l'éviction
+        uint64_t last_used = 0;
+        // Pas de place dans le budget cette frame : dessinée directement à chaque composite
+        bool uncached = false;
+    };
+
+    SDL_Renderer *m_renderer;
+    Draw_batch m_batch;
+    Frame_invalidation *m_frame_invalidation = nullptr;
+
+    mutable std::mutex m_mtx;
+    Registry<Layer> m_layers;
+    uint64_t m_next_order = 0;
+
+    // Couches triées par (z_order, ordre de création), retrié seulement après un changement
+    std::vector<Handle> m_z_sorted;
+    bool m_sort_dirty = false;
+
+    size_t m_budget_bytes = size_t(128) * 1024 * 1024;
+    size_t m_cache_bytes = 0;
+    uint64_t m_frame = 0;
+
+    // Les textures ne sont détruites que sur le thread de rendu, au prochain update()
+    std::vector<SDL_Texture *> m_retired_textures;
+    std::vector<SDL_Rect> m_damage;
+
+    Layer_statistics m_statistics;
+
+private:
+    static size_t texture_bytes(int width, int height);
+    void release_texture(Layer &layer);
+    bool evict_least_recently_used();
+    void sort_layers();
+    void rasterize(Layer &layer);
+    void draw_direct(const Layer &layer);
+    void add_damage(const SDL_Rect &rect);
+    void signal_change();
+
+public:
+    Layer_cache() = delete;
+    explicit Layer_cache(SDL_Renderer *renderer);
+    Layer_cache(const Layer_cache&) = delete;
+    Layer_cache& operator=(const Layer_cache&) = delete;
+    ~Layer_cache();
+
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+    // Budget des textures en octets, les couches en trop sont libérées au prochain update()
+    void set_budget(size_t bytes);
+
+    // Ajoute ou remplace la couche 'id', elle sera redessinée à la prochaine frame
+    Handle set_layer(const std::string &id, int z_order, SDL_Rect area, Draw_function draw);
+    bool invalidate_layer(Handle handle);
+    bool invalidate_layer_by_id(const std::string &id);
+    // Un simple déplacement garde la texture, un changement de taille la redessine
+    bool set_layer_area(Handle handle, SDL_Rect area);
+    bool set_layer_z_order(Handle handle, int z_order);
+    bool set_layer_visible(Handle handle, bool visible);
+    bool delete_layer(Handle handle);
+    bool delete_layer_by_id(const std::string &id);
+    [[nodiscard]] Handle return_layer_handle(const std::string &id) const;
+    void clear();
+
+    // Une fois par frame : éviction puis rastérisation des couches invalidées dans leur texture
+    void update();
+    // Copie des couches visibles sur la cible courante, limitée par son clip
+    void composite();
+    // Zones des couches modifiées depuis la dernière frame
+    void append_pending_damage(std::vector<SDL_Rect> &rects);
+
+    [[nodiscard]] Layer_statistics return_statistics() const;
+};
+
+
+#endif //MEINCANVAS_LAYER_CACHE_HPP
@@ -0,0 +1,271 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "pixel_kernels.hpp"
+
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MEINCANVAS_X86_KERNELS
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define MEINCANVAS_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+
+// Mélange "over" d'une couleur d'alpha a sur un pixel, canal par canal :
+//     t = src * a + dst * (255 - a) + 128, résultat = (t + (t >> 8)) >> 8
+// c'est la division par 255 arrondie au plus proche, sans division
+// Pour le canal alpha la source vaut 255, ce qui donne a + dst_a * (1 - a)
+// Toutes les valeurs intermédiaires tiennent sur 16 bits, les versions SIMD travaillent donc sur des u16
+
+namespace
+{
+    // Termes constants de la source, rangés dans l'ordre des octets en mémoire (B, G, R, A)
+    struct Blend_terms
+    {
+        uint16_t src[4];
+        uint16_t inverse_alpha;
+    };
+
+    Blend_terms make_blend_terms(uint32_t color)
+    {
+        uint32_t alpha = color >> 24;
+        Blend_terms terms{};
+        terms.src[0] = uint16_t((color & 0xFF) * alpha + 128);
+        terms.src[1] = uint16_t(((color >> 8) & 0xFF) * alpha + 128);
+        terms.src[2] = uint16_t(((color >> 16) & 0xFF) * alpha + 128);
+        terms.src[3] = uint16_t(255 * alpha + 128);
+        terms.inverse_alpha = uint16_t(255 - alpha);
+        return terms;
+    }
+
+    inline uint32_t blend_pixel(uint32_t dst, const Blend_terms &terms)
+    {
+        uint32_t result = 0;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            uint32_t t = terms.src[channel] + ((dst >> (channel * 8)) & 0xFF) * terms.inverse_alpha;
+            result |= ((t + (t >> 8)) >> 8) << (channel * 8);
+        }
+        return result;
+    }
+
+
+    // ---------------------------------------------------------------- Scalaire
+
+    void fill_span_scalar(uint32_t *dst, size_t count, uint32_t color)
+    {
+        for (size_t i = 0; i < count; i++)
+            dst[i] = color;
+    }
+
+    void blend_span_scalar(uint32_t *dst, size_t count, uint32_t color)
+    {
+        Blend_terms terms = make_blend_terms(color);
+        for (size_t i = 0; i < count; i++)
+            dst[i] = blend_pixel(dst[i], terms);
+    }
+
+    void blit_span_scaled_scalar(uint32_t *dst, size_t count, const uint32_t *src_row, uint32_t x_start, uint32_t x_step)
+    {
+        uint32_t x = x_start;
+        for (size_t i = 0; i < count; i++, x += x_step)
+            dst[i] = src_row[x >> 16];
+    }
+
+
+#if defined(MEINCANVAS_X86_KERNELS)
+
+    // ---------------------------------------------------------------- SSE4.1, 4 pixels par itération
+
+    __attribute__((target("sse4.1")))
+    void fill_span_sse4(uint32_t *dst, size_t count, uint32_t color)
+    {
+        __m128i value = _mm_set1_epi32(int(color));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), value);
+        for (; i < count; i++)
+            dst[i] = color;
+    }
+
+    __attribute__((target("sse4.1")))
+    void blend_span_sse4(uint32_t *dst, size_t count, uint32_t color)
+    {
+        Blend_terms terms = make_blend_terms(color);
+        __m128i src = _mm_setr_epi16(short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]),
+                                     short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]));
+        __m128i inverse_alpha = _mm_set1_epi16(short(terms.inverse_alpha));
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+            __m128i low = _mm_cvtepu8_epi16(pixels);
+            __m128i high = _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8));
+
+            low = _mm_add_epi16(src, _mm_mullo_epi16(low, inverse_alpha));
+            high = _mm_add_epi16(src, _mm_mullo_epi16(high, inverse_alpha));
+            low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+            high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(low, high));
+        }
+        for (; i < count; i++)
+            dst[i] = blend_pixel(dst[i], terms);
+    }
+
+
+    // ---------------------------------------------------------------- AVX2, 8 pixels par itération
+
+    __attribute__((target("avx2")))
+    void fill_span_avx2(uint32_t *dst, size_t count, uint32_t color)
+    {
+        __m256i value = _mm256_set1_epi32(int(color));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), value);
+        for (; i < count; i++)
+            dst[i] = color;
+    }
+
+    __attribute__((target("avx2")))
+    void blend_span_avx2(uint32_t *dst, size_t count, uint32_t color)
+    {
+        Blend_terms terms = make_blend_terms(color);
+        __m256i src = _mm256_setr_epi16(short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]),
+                                        short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]),
+                                        short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]),
+                                        short(terms.src[0]), short(terms.src[1]), short(terms.src[2]), short(terms.src[3]));
+        __m256i inverse_alpha = _mm256_set1_epi16(short(terms.inverse_alpha));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+            __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels));
+            __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1));
+
+            low = _mm256_add_epi16(src, _mm256_mullo_epi16(low, inverse_alpha));
+            high = _mm256_add_epi16(src, _mm256_mullo_epi16(high, inverse_alpha));
+            low = _mm256_srli_epi16(_mm256_add_epi16(low, _mm256_srli_epi16(low, 8)), 8);
+            high = _mm256_srli_epi16(_mm256_add_epi16(high, _mm256_srli_epi16(high, 8)), 8);
+
+            // packus travaille par moitié de 128 bits, on remet les pixels dans l'ordre
+            __m256i packed = _mm256_packus_epi16(low, high);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+        for (; i < count; i++)
+            dst[i] = blend_pixel(dst[i], terms);
+    }
+
+    __attribute__((target("avx2")))
+    void blit_span_scaled_avx2(uint32_t *dst, size_t count, const uint32_t *src_row, uint32_t x_start, uint32_t x_step)
+    {
+        // Les 8 positions sources sont lues en un seul gather
+        __m256i x = _mm256_add_epi32(_mm256_set1_epi32(int(x_start)),
+                                     _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int(x_step))));
+        __m256i step = _mm256_set1_epi32(int(x_step * 8));
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i index = _mm256_srli_epi32(x, 16);
+            __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int *>(src_row), index, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), pixels);
+            x = _mm256_add_epi32(x, step);
+        }
+
+        uint32_t position = x_start + uint32_t(i) * x_step;
+        for (; i < count; i++, position += x_step)
+            dst[i] = src_row[position >> 16];
+    }
+
+#elif defined(MEINCANVAS_NEON_KERNELS)
+
+    // ---------------------------------------------------------------- NEON, 4 pixels par itération
+
+    void fill_span_neon(uint32_t *dst, size_t count, uint32_t color)
+    {
+        uint32x4_t value = vdupq_n_u32(color);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            vst1q_u32(dst + i, value);
+        for (; i < count; i++)
+            dst[i] = color;
+    }
+
+    void blend_span_neon(uint32_t *dst, size_t count, uint32_t color)
+    {
+        Blend_terms terms = make_blend_terms(color);
+        const uint16_t src_lanes[8] = {terms.src[0], terms.src[1], terms.src[2], terms.src[3],
+                                       terms.src[0], terms.src[1], terms.src[2], terms.src[3]};
+        uint16x8_t src = vld1q_u16(src_lanes);
+        uint16x8_t inverse_alpha = vdupq_n_u16(terms.inverse_alpha);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            uint8x16_t pixels = vld1q_u8(reinterpret_cast<const uint8_t *>(dst + i));
+            uint16x8_t low = vmlaq_u16(src, vmovl_u8(vget_low_u8(pixels)), inverse_alpha);
+            uint16x8_t high = vmlaq_u16(src, vmovl_u8(vget_high_u8(pixels)), inverse_alpha);
+            low = vshrq_n_u16(vsraq_n_u16(low, low, 8), 8);
+            high = vshrq_n_u16(vsraq_n_u16(high, high, 8), 8);
+            vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+        for (; i < count; i++)
+            dst[i] = blend_pixel(dst[i], terms);
+    }
+
+#endif
+
+    const Pixel_kernels scalar_kernels{Simd_level::SCALAR, fill_span_scalar, blend_span_scalar, blit_span_scaled_scalar};
+
+#if defined(MEINCANVAS_X86_KERNELS)
+    // Pas de gather avant AVX2, la copie mise à l'échelle reste scalaire en SSE4
+    const Pixel_kernels sse4_kernels{Simd_level::SSE4, fill_span_sse4, blend_span_sse4, blit_span_scaled_scalar};
+    const Pixel_kernels avx2_kernels{Simd_level::AVX2, fill_span_avx2, blend_span_avx2, blit_span_scaled_avx2};
+#elif defined(MEINCANVAS_NEON_KERNELS)
+    const Pixel_kernels neon_kernels{Simd_level::NEON, fill_span_neon, blend_span_neon, blit_span_scaled_scalar};
+#endif
+}
+
+
+const Pixel_kernels *return_pixel_kernels(Simd_level level)
+{
+    switch (level)
+    {
+        case Simd_level::SCALAR:
+            return &scalar_kernels;
+#if defined(MEINCANVAS_X86_KERNELS)
+        case Simd_level::SSE4:
+            return __builtin_cpu_supports("sse4.1") ? &sse4_kernels : nullptr;
+        case Simd_level::AVX2:
+            return __builtin_cpu_supports("avx2") ? &avx2_kernels : nullptr;
+#elif defined(MEINCANVAS_NEON_KERNELS)
+        case Simd_level::NEON:
+            return &neon_kernels;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+
+const Pixel_kernels &return_pixel_kernels()
+{
+    // Choix fait une seule fois, du plus rapide au plus lent
+    static const Pixel_kernels &kernels = []() -> const Pixel_kernels & {
+        for (Simd_level level : {Simd_level::AVX2, Simd_level::NEON, Simd_level::SSE4})
+        {
+            if (const Pixel_kernels *candidate = return_pixel_kernels(level))
+                return *candidate;
+        }
+        return scalar_kernels;
+    }();
+
+    return kernels;
+}
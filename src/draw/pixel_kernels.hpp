@@ -0,0 +1,46 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_PIXEL_KERNELS_HPP
+#define MEINCANVAS_PIXEL_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Jeu d'instructions utilisé par les noyaux de pixels
+enum class Simd_level
+{
+    SCALAR,
+    SSE4,
+    AVX2,
+    NEON
+};
+
+
+// Noyaux qui travaillent sur une ligne de pixels ARGB8888 (0xAARRGGBB)
+// Toutes les versions donnent exactement le même résultat que la version scalaire
+struct Pixel_kernels
+{
+    Simd_level level;
+
+    // dst[0..count[ = color
+    void (*fill_span)(uint32_t *dst, size_t count, uint32_t color);
+
+    // dst[0..count[ = color par-dessus dst (mélange alpha "over", arrondi exact de la division par 255)
+    void (*blend_span)(uint32_t *dst, size_t count, uint32_t color);
+
+    // Copie mise à l'échelle au plus proche voisin : dst[i] = src_row[(x_start + i * x_step) >> 16]
+    void (*blit_span_scaled)(uint32_t *dst, size_t count, const uint32_t *src_row, uint32_t x_start, uint32_t x_step);
+};
+
+
+// Meilleurs noyaux disponibles sur ce processeur, choisis une seule fois au premier appel
+const Pixel_kernels &return_pixel_kernels();
+
+// Noyaux d'un niveau précis, ou nullptr s'il n'est pas disponible (comparaison avec le scalaire, mesures)
+const Pixel_kernels *return_pixel_kernels(Simd_level level);
+
+
+#endif //MEINCANVAS_PIXEL_KERNELS_HPP
@@ -0,0 +1,481 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "text_renderer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+
+namespace
+{
+    // Un pixel vide entre les glyphes pour que le filtrage ne mélange pas deux voisins
+    constexpr int glyph_padding = 1;
+
+    uint64_t glyph_key(Handle font, uint32_t codepoint)
+    {
+        return (uint64_t(font.index) << 32) | codepoint;
+    }
+}
+
+
+Text_renderer::Text_renderer(SDL_Renderer *renderer) : m_renderer(renderer)
+{
+}
+
+
+Text_renderer::~Text_renderer()
+{
+    for (auto &page : m_pages)
+    {
+        if (page.texture)
+            SDL_DestroyTexture(page.texture);
+    }
+
+    m_fonts.for_each([](Handle, Font &font) {
+        TTF_CloseFont(font.font);
+    });
+}
+
+
+uint32_t Text_renderer::next_codepoint(const std::string &text, size_t &position)
+{
+    // Décodage UTF-8, une séquence invalide donne U+FFFD et avance d'un octet
+    auto byte = [&text](size_t i) { return uint32_t(uint8_t(text[i])); };
+    uint32_t first = byte(position);
+
+    int length = first < 0x80 ? 1 : (first >> 5) == 0x6 ? 2 : (first >> 4) == 0xE ? 3 : (first >> 3) == 0x1E ? 4 : 0;
+    if (length == 0 || position + size_t(length) > text.size())
+    {
+        position++;
+        return 0xFFFD;
+    }
+
+    uint32_t codepoint = length == 1 ? first : first & (0x7F >> length);
+    for (int i = 1; i < length; i++)
+    {
+        uint32_t next = byte(position + size_t(i));
+        if ((next & 0xC0) != 0x80)
+        {
+            position++;
+            return 0xFFFD;
+        }
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+
+    position += size_t(length);
+    return codepoint;
+}
+
+
+Handle Text_renderer::load_font(const std::string &id, const std::string &path, int size)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_fonts.find(id).is_valid())
+    {
+        std::cout << "Font with id " << id << " already exists" << std::endl;
+        return Handle{};
+    }
+
+    TTF_Font *font = TTF_OpenFont(path.c_str(), size);
+    if (!font)
+    {
+        std::cout << "Font " << path << " could not be loaded : " << TTF_GetError() << std::endl;
+        return Handle{};
+    }
+
+    return m_fonts.insert(Font{font, size, TTF_FontHeight(font)}, id);
+}
+
+
+void Text_renderer::purge_font(Handle font_handle)
+{
+    // Les glyphes de la police restent dans leurs pages jusqu'à leur éviction, seules leurs entrées disparaissent
+    for (auto it = m_glyphs.begin(); it != m_glyphs.end();)
+    {
+        if ((it->first >> 32) == font_handle.index)
+            it = m_glyphs.erase(it);
+        else
+            ++it;
+    }
+
+    // La clé d'une mise en page commence par la poignée de sa police
+    const uint64_t font_key = font_handle.to_key();
+    for (auto it = m_layouts.begin(); it != m_layouts.end();)
+    {
+        if (it->first.compare(0, sizeof(font_key), reinterpret_cast<const char *>(&font_key), sizeof(font_key)) == 0)
+            it = m_layouts.erase(it);
+        else
+            ++it;
+    }
+
+    m_atlas_generation++;
+}
+
+
+bool Text_renderer::delete_font(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Font *font = m_fonts.get(handle);
+    if (!font)
+        return false;
+
+    purge_font(handle);
+    TTF_CloseFont(font->font);
+    m_fonts.erase(handle);
+    return true;
+}
+
+
+bool Text_renderer::delete_font_by_id(const std::string &id)
+{
+    return delete_font(return_font_handle(id));
+}
+
+
+Handle Text_renderer::return_font_handle(const std::string &id) const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_fonts.find(id);
+}
+
+
+void Text_renderer::set_max_pages(size_t pages)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_max_pages = std::max<size_t>(pages, 1);
+}
+
+
+size_t Text_renderer::allocated_pages() const
+{
+    return size_t(std::count_if(m_pages.begin(), m_pages.end(), [](const Page &page) { return page.texture != nullptr; }));
+}
+
+
+bool Text_renderer::insert_in_page(Page &page, int width, int height, SDL_Rect &rect) const
+{
+    // Étagères : on prend la première assez haute sans gâcher plus d'un quart de sa hauteur
+    for (auto &shelf : page.shelves)
+    {
+        if (height <= shelf.height && shelf.height <= height + height / 4 + 1 && shelf.x + width <= page_size)
+        {
+            rect = SDL_Rect{shelf.x, shelf.y, width, height};
+            shelf.x += width + glyph_padding;
+            return true;
+        }
+    }
+
+    // Sinon une nouvelle étagère sous les autres
+    if (page.next_y + height > page_size || width > page_size)
+        return false;
+
+    page.shelves.push_back(Shelf{page.next_y, height, width + glyph_padding});
+    rect = SDL_Rect{0, page.next_y, width, height};
+    page.next_y += height + glyph_padding;
+    return true;
+}
+
+
+void Text_renderer::evict_page(uint32_t page_index)
+{
+    // Tous les glyphes de la page sont oubliés, les mises en page qui les utilisaient seront résolues à nouveau
+    Page &page = m_pages[page_index];
+    for (uint64_t key : page.glyph_keys)
+    {
+        auto it = m_glyphs.find(key);
+        if (it != m_glyphs.end() && it->second.page == page_index)
+            m_glyphs.erase(it);
+    }
+
+    page.glyph_keys.clear();
+    page.shelves.clear();
+    page.next_y = 0;
+    m_atlas_generation++;
+    m_statistics.pages_evicted++;
+}
+
+
+bool Text_renderer::allocate(int width, int height, uint32_t &page_index, SDL_Rect &rect)
+{
+    for (uint32_t i = 0; i < uint32_t(m_pages.size()); i++)
+    {
+        if (m_pages[i].texture && insert_in_page(m_pages[i], width, height, rect))
+        {
+            page_index = i;
+            return true;
+        }
+    }
+
+    // Atlas plein et budget atteint : on vide la page la moins récemment utilisée, jamais une page de la frame en cours
+    if (allocated_pages() >= m_max_pages)
+    {
+        uint32_t oldest = no_page;
+        for (uint32_t i = 0; i < uint32_t(m_pages.size()); i++)
+        {
+            if (m_pages[i].texture && m_pages[i].last_used < m_frame && (oldest == no_page || m_pages[i].last_used < m_pages[oldest].last_used))
+                oldest = i;
+        }
+
+        if (oldest != no_page)
+        {
+            evict_page(oldest);
+            page_index = oldest;
+            return insert_in_page(m_pages[oldest], width, height, rect);
+        }
+    }
+
+    // Sinon une nouvelle page, au-delà du budget si toutes servent déjà à cette frame (rendue à la fin de la frame)
+    auto free_slot = std::find_if(m_pages.begin(), m_pages.end(), [](const Page &page) { return page.texture == nullptr; });
+    page_index = uint32_t(free_slot - m_pages.begin());
+    if (free_slot == m_pages.end())
+        m_pages.emplace_back();
+
+    Page &page = m_pages[page_index];
+    page.texture = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, page_size, page_size);
+    if (!page.texture)
+    {
+        std::cout << "Glyph atlas page could not be created : " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(page.texture, SDL_BLENDMODE_BLEND);
+    return insert_in_page(page, width, height, rect);
+}
+
+
+const Text_renderer::Glyph *Text_renderer::find_glyph(const Font &font, Handle font_handle, uint32_t codepoint)
+{
+    uint64_t key = glyph_key(font_handle, codepoint);
+    auto it = m_glyphs.find(key);
+    if (it != m_glyphs.end())
+        return &it->second;
+
+    // Premier usage du glyphe : rastérisé en blanc, la couleur est appliquée par les sommets
+    Glyph glyph{no_page, SDL_Rect{0, 0, 0, 0}, 0};
+    int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+    if (TTF_GlyphMetrics32(font.font, codepoint, &min_x, &max_x, &min_y, &max_y, &glyph.advance) != 0)
+        glyph.advance = 0;
+
+    SDL_Surface *surface = nullptr;
+    if (max_x > min_x)
+        surface = TTF_RenderGlyph32_Blended(font.font, codepoint, SDL_Color{255, 255, 255, 255});
+    m_statistics.glyphs_rasterized++;
+
+    if (surface && surface->format->format != SDL_PIXELFORMAT_ARGB8888)
+    {
+        SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        surface = converted;
+    }
+
+    if (surface)
+    {
+        uint32_t page_index;
+        SDL_Rect rect;
+        if (allocate(surface->w, surface->h, page_index, rect))
+        {
+            SDL_UpdateTexture(m_pages[page_index].texture, &rect, surface->pixels, surface->pitch);
+            m_pages[page_index].glyph_keys.push_back(key);
+            m_pages[page_index].last_used = m_frame;
+            glyph.page = page_index;
+            glyph.rect = rect;
+        }
+        SDL_FreeSurface(surface);
+    }
+
+    return &m_glyphs.emplace(key, glyph).first->second;
+}
+
+
+Text_renderer::Layout *Text_renderer::find_layout(const Font &font, Handle font_handle, const std::string &text)
+{
+    // Clé = poignée de la police + texte, construite dans un tampon réutilisé pour ne pas allouer à chaque appel
+    const uint64_t font_key = font_handle.to_key();
+    m_layout_key.assign(reinterpret_cast<const char *>(&font_key), sizeof(font_key));
+    m_layout_key.append(text);
+
+    auto it = m_layouts.find(m_layout_key);
+    if (it != m_layouts.end())
+    {
+        m_statistics.layout_hits++;
+    }
+    else
+    {
+        // Mise en page une seule fois par chaîne : avances et crénage entre glyphes voisins
+        m_statistics.layout_misses++;
+        Layout layout{{}, 0, font.height, UINT64_MAX, 0};
+        int pen_x = 0;
+        uint32_t previous = 0;
+        for (size_t position = 0; position < text.size();)
+        {
+            uint32_t codepoint = next_codepoint(text, position);
+            if (previous != 0)
+                pen_x += TTF_GetFontKerningSizeGlyphs32(font.font, previous, codepoint);
+
+            layout.glyphs.push_back(Layout_glyph{glyph_key(font_handle, codepoint), pen_x, nullptr});
+            const Glyph *glyph = find_glyph(font, font_handle, codepoint);
+            pen_x += glyph->advance;
+            layout.width = std::max(layout.width, pen_x);
+            previous = codepoint;
+        }
+
+        it = m_layouts.emplace(m_layout_key, std::move(layout)).first;
+    }
+
+    // Les pointeurs de glyphes ne sont résolus à nouveau que si une page a été vidée depuis
+    Layout &layout = it->second;
+    if (layout.atlas_generation != m_atlas_generation)
+    {
+        for (auto &layout_glyph : layout.glyphs)
+        {
+            layout_glyph.glyph = find_glyph(font, font_handle, uint32_t(layout_glyph.key));
+            if (layout_glyph.glyph->page != no_page)
+                m_pages[layout_glyph.glyph->page].last_used = m_frame;
+        }
+        layout.atlas_generation = m_atlas_generation;
+    }
+
+    layout.last_used = m_frame;
+    return &layout;
+}
+
+
+bool Text_renderer::draw_text(Handle font, const std::string &text, int x, int y, SDL_Color color)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    const Font *font_entry = m_fonts.get(font);
+    if (!font_entry)
+        return false;
+
+    if (text.empty())
+        return true;
+
+    const Layout *layout = find_layout(*font_entry, font, text);
+
+    // Un quad par glyphe visible, rangé dans la file de sa page
+    for (const auto &layout_glyph : layout->glyphs)
+    {
+        const Glyph &glyph = *layout_glyph.glyph;
+        if (glyph.page == no_page)
+            continue;
+
+        Page &page = m_pages[glyph.page];
+        page.last_used = m_frame;
+
+        float left = float(x + layout_glyph.x), top = float(y);
+        float right = left + float(glyph.rect.w), bottom = top + float(glyph.rect.h);
+        float u0 = float(glyph.rect.x) / float(page_size), v0 = float(glyph.rect.y) / float(page_size);
+        float u1 = float(glyph.rect.x + glyph.rect.w) / float(page_size), v1 = float(glyph.rect.y + glyph.rect.h) / float(page_size);
+
+        int base = int(page.vertices.size());
+        page.vertices.push_back(SDL_Vertex{{left, top}, color, {u0, v0}});
+        page.vertices.push_back(SDL_Vertex{{right, top}, color, {u1, v0}});
+        page.vertices.push_back(SDL_Vertex{{right, bottom}, color, {u1, v1}});
+        page.vertices.push_back(SDL_Vertex{{left, bottom}, color, {u0, v1}});
+        page.indices.insert(page.indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+        m_statistics.last_quads++;
+    }
+
+    SDL_Rect text_rect{x, y, layout->width, layout->height};
+    if (m_bounds.w <= 0 || m_bounds.h <= 0)
+        m_bounds = text_rect;
+    else
+        SDL_UnionRect(&m_bounds, &text_rect, &m_bounds);
+
+    return true;
+}
+
+
+bool Text_renderer::measure_text(Handle font, const std::string &text, int &width, int &height)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    const Font *font_entry = m_fonts.get(font);
+    if (!font_entry)
+        return false;
+
+    const Layout *layout = find_layout(*font_entry, font, text);
+    width = layout->width;
+    height = layout->height;
+    return true;
+}
+
+
+void Text_renderer::submit()
+{
+    // Un appel par page : le texte de deux pages différentes ne se recouvre pas dans l'ordre d'appel
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_statistics.last_draw_calls = 0;
+    for (const auto &page : m_pages)
+    {
+        if (!page.texture || page.indices.empty())
+            continue;
+
+        SDL_RenderGeometry(m_renderer, page.texture, page.vertices.data(), int(page.vertices.size()),
+                           page.indices.data(), int(page.indices.size()));
+        m_statistics.last_draw_calls++;
+    }
+}
+
+
+void Text_renderer::end_frame()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto &page : m_pages)
+    {
+        page.vertices.clear();
+        page.indices.clear();
+    }
+    m_bounds = SDL_Rect{0, 0, 0, 0};
+    m_statistics.last_quads = 0;
+
+    // Pages ajoutées au-delà du budget pendant la frame : on rend les moins récemment utilisées
+    while (allocated_pages() > m_max_pages)
+    {
+        auto oldest = m_pages.end();
+        for (auto it = m_pages.begin(); it != m_pages.end(); ++it)
+        {
+            if (it->texture && (oldest == m_pages.end() || it->last_used < oldest->last_used))
+                oldest = it;
+        }
+
+        evict_page(uint32_t(oldest - m_pages.begin()));
+        SDL_DestroyTexture(oldest->texture);
+        oldest->texture = nullptr;
+    }
+
+    // Les mises en page inutilisées pendant cette frame sont oubliées quand il y en a trop
+    if (m_layouts.size() > m_max_layouts)
+    {
+        for (auto it = m_layouts.begin(); it != m_layouts.end();)
+        {
+            if (it->second.last_used < m_frame)
+                it = m_layouts.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    m_frame++;
+}
+
+
+bool Text_renderer::return_bounds(SDL_Rect &bounds) const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    bounds = m_bounds;
+    return m_bounds.w > 0 && m_bounds.h > 0;
+}
+
+
+Text_statistics Text_renderer::return_statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    Text_statistics statistics = m_statistics;
+    statistics.fonts = m_fonts.size();
+    statistics.glyphs = m_glyphs.size();
+    statistics.pages = allocated_pages();
+    statistics.layouts = m_layouts.size();
+    return statistics;
+}
@@ -0,0 +1,151 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_TEXT_RENDERER_HPP
+#define MEINCANVAS_TEXT_RENDERER_HPP
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../registry/registry.hpp"
+
+
+struct Text_statistics
+{
+    size_t fonts = 0;
+    size_t glyphs = 0;              // Glyphes présents dans l'atlas
+    size_t pages = 0;               // Pages d'atlas allouées
+    size_t layouts = 0;             // Chaînes dont la mise en page est en cache
+
+    uint64_t glyphs_rasterized = 0; // Appels à SDL_ttf depuis le début, un par glyphe et non par chaîne
+    uint64_t pages_evicted = 0;
+    uint64_t layout_hits = 0;
+    uint64_t layout_misses = 0;
+
+    // Dernière frame
+    size_t last_quads = 0;
+    size_t last_draw_calls = 0;
+};
+
+
+// Texte dessiné depuis un atlas de glyphes : chaque glyphe est rastérisé une seule fois par SDL_ttf
+// puis rangé par étagères dans une page de l'atlas (une texture)
+// La mise en page d'une chaîne (glyphes et positions, crénage compris) est gardée en cache par (police, texte)
+// Le texte d'une frame part en un SDL_RenderGeometry par page utilisée, quel que soit le nombre de chaînes
+// Les pages respectent un budget : quand l'atlas est plein, la page inutilisée depuis le plus longtemps est vidée
+class Text_renderer {
+private:
+    struct Font {
+        TTF_Font *font;
+        int size;
+        int height;
+    };
+
+    struct Glyph {
+        // Page de l'atlas, no_page pour un glyphe sans pixels (espace)
+        uint32_t page;
+        SDL_Rect rect;
+        int advance;
+    };
+
+    struct Shelf {
+        int y;
+        int height;
+        int x;
+    };
+
+    struct Page {
+        SDL_Texture *texture = nullptr;
+        std::vector<Shelf> shelves;
+        int next_y = 0;
+        std::vector<uint64_t> glyph_keys;
+        uint64_t last_used = 0;
+
+        // Quads de la frame pour cette page
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    struct Layout_glyph {
+        uint64_t key;
+        int x;
+        const Glyph *glyph;
+    };
+
+    struct Layout {
+        std::vector<Layout_glyph> glyphs;
+        int width;
+        int height;
+        // Génération de l'atlas à laquelle les pointeurs de glyphes ont été résolus
+        uint64_t atlas_generation;
+        uint64_t last_used;
+    };
+
+    static constexpr uint32_t no_page = UINT32_MAX;
+
+    SDL_Renderer *m_renderer;
+    mutable std::mutex m_mtx;
+
+    Registry<Font> m_fonts;
+    std::unordered_map<uint64_t, Glyph> m_glyphs;
+    std::vector<Page> m_pages;
+    size_t m_max_pages = 4;
+    uint64_t m_atlas_generation = 0;
+
+    std::unordered_map<std::string, Layout> m_layouts;
+    std::string m_layout_key;
+    size_t m_max_layouts = 4096;
+
+    uint64_t m_frame = 1;
+    SDL_Rect m_bounds{0, 0, 0, 0};
+    Text_statistics m_statistics;
+
+private:
+    static uint32_t next_codepoint(const std::string &text, size_t &position);
+    size_t allocated_pages() const;
+    bool insert_in_page(Page &page, int width, int height, SDL_Rect &rect) const;
+    bool allocate(int width, int height, uint32_t &page_index, SDL_Rect &rect);
+    void evict_page(uint32_t page_index);
+    const Glyph *find_glyph(const Font &font, Handle font_handle, uint32_t codepoint);
+    Layout *find_layout(const Font &font, Handle font_handle, const std::string &text);
+    void purge_font(Handle font_handle);
+
+public:
+    Text_renderer() = delete;
+    explicit Text_renderer(SDL_Renderer *renderer);
+    Text_renderer(const Text_renderer&) = delete;
+    Text_renderer& operator=(const Text_renderer&) = delete;
+    ~Text_renderer();
+
+    // Une police par taille, 'id' la désigne ensuite
+    Handle load_font(const std::string &id, const std::string &path, int size);
+    bool delete_font(Handle handle);
+    bool delete_font_by_id(const std::string &id);
+    [[nodiscard]] Handle return_font_handle(const std::string &id) const;
+
+    // Nombre de pages d'atlas gardées entre deux frames (une page fait page_size x page_size pixels)
+    void set_max_pages(size_t pages);
+
+    // Met le texte en file, (x, y) est le coin haut gauche de la ligne
+    bool draw_text(Handle font, const std::string &text, int x, int y, SDL_Color color);
+    bool measure_text(Handle font, const std::string &text, int &width, int &height);
+
+    // Même fonctionnement que Draw_batch : submit peut être appelé une fois par zone de clip, end_frame vide la file
+    void submit();
+    void end_frame();
+
+    [[nodiscard]] bool return_bounds(SDL_Rect &bounds) const;
+    [[nodiscard]] Text_statistics return_statistics() const;
+
+    static constexpr int page_size = 1024;
+};
+
+
+#endif //MEINCANVAS_TEXT_RENDERER_HPP
@@ -4,10 +4,16 @@
 
 #include "event.hpp"
 
+#include <algorithm>
+#include <iostream>
 
-namespace Event_Mutex
+
+Event_queue::Event_queue(size_t capacity) : m_events(capacity)
 {
-    std::mutex mtx;
+    // SDL doit déjà être initialisée pour enregistrer un type d'événement
+    m_wake_up_event_type = SDL_RegisterEvents(1);
+    if (m_wake_up_event_type == static_cast<Uint32>(-1))
+        std::cout << "Unable to register the wake up event : " << SDL_GetError() << std::endl;
 }
 
 
@@ -15,47 +21,190 @@ void Event_queue::poll_events()
 {
     SDL_Event event;
     // SDL_PollEvent renvoie 1 si un événement est disponible et le met dans 'event'
-    if (SDL_PollEvent(&event)) {
-        // Verrouille le mutex pour protéger l'accès aux données partagées
-        std::unique_lock<std::mutex> lock(Event_Mutex::mtx);
-        // Met à jour le dernier événement et indique qu'un nouvel événement est disponible
-        last_event = event;
-        new_event_available = true;
-        // Déverrouille le mutex
-        lock.unlock();
+    // On récupère tous les événements en attente, pas seulement le premier
+    m_poll_batch.clear();
+    while (SDL_PollEvent(&event)) {
+        m_poll_batch.push_back(event);
+    }
+
+    publish_batch();
+}
+
+bool Event_queue::wait_events(int timeout_ms)
+{
+    SDL_Event event;
+    // On dort jusqu'au premier événement, à la fin du délai, ou jusqu'à un appel à wake_up
+    m_poll_batch.clear();
+    if (!SDL_WaitEventTimeout(&event, timeout_ms))
+        return false;
+
+    // Puis on récupère d'un coup tous ceux qui sont arrivés en même temps
+    m_poll_batch.push_back(event);
+    while (SDL_PollEvent(&event)) {
+        m_poll_batch.push_back(event);
+    }
+
+    publish_batch();
+    return true;
+}
+
+void Event_queue::wake_up()
+{
+    // SDL_PushEvent peut être appelé depuis n'importe quel thread, wait_events se réveille immédiatement
+    SDL_Event event{};
+    event.type = m_wake_up_event_type;
+    SDL_PushEvent(&event);
+}
+
+void Event_queue::publish_batch()
+{
+    // L'événement de réveil ne concerne que wait_events, on ne le transmet pas
+    m_poll_batch.erase(std::remove_if(m_poll_batch.begin(), m_poll_batch.end(), [this](const SDL_Event &event) {
+        return event.type == m_wake_up_event_type;
+    }), m_poll_batch.end());
+
+    if (m_poll_batch.empty())
+        return;
+
+    // On fusionne les mouvements de souris consécutifs et les redimensionnements avant de publier
+    coalesce_events(m_poll_batch);
+
+    bool new_events = false;
+    for (const auto &batch_event : m_poll_batch) {
+        // Si la file est pleine l'événement est compté comme perdu
+        new_events |= m_events.push(batch_event);
+        m_bus.publish(batch_event);
+    }
+
+    if (new_events) {
         // Notifie tous les threads en attente qu'un nouvel événement est disponible
-        cond_var.notify_all();
+        m_events_sequence.fetch_add(1, std::memory_order_release);
+        m_events_sequence.notify_all();
+    }
+
+    // Une entrée a changé quelque chose, la boucle de rendu doit redessiner
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+}
+
+void Event_queue::coalesce_events(std::vector<SDL_Event> &events)
+{
+    bool merge_motion = m_merge_motion;
+    bool keep_last_resize = m_keep_last_resize;
+    if (!merge_motion && !keep_last_resize)
+        return;
+
+    // On repère le dernier redimensionnement de chaque type, les précédents sont inutiles
+    long last_resized = -1, last_size_changed = -1;
+    if (keep_last_resize) {
+        for (size_t i = 0; i < events.size(); i++) {
+            if (events[i].type != SDL_WINDOWEVENT)
+                continue;
+            if (events[i].window.event == SDL_WINDOWEVENT_RESIZED)
+                last_resized = static_cast<long>(i);
+            else if (events[i].window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                last_size_changed = static_cast<long>(i);
+        }
+    }
+
+    // Compactage en place : les clics et les touches ne sont jamais retirés ni déplacés l'un par rapport à l'autre
+    size_t kept = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        const SDL_Event &current = events[i];
+
+        if (keep_last_resize && current.type == SDL_WINDOWEVENT) {
+            if ((current.window.event == SDL_WINDOWEVENT_RESIZED && static_cast<long>(i) != last_resized) ||
+                (current.window.event == SDL_WINDOWEVENT_SIZE_CHANGED && static_cast<long>(i) != last_size_changed)) {
+                continue;
+            }
+        }
+
+        // Un mouvement qui suit directement un autre mouvement du même périphérique y est fusionné :
+        // on garde la dernière position et on cumule les déplacements relatifs
+        if (merge_motion && current.type == SDL_MOUSEMOTION && kept > 0) {
+            SDL_Event &previous = events[kept - 1];
+            if (previous.type == SDL_MOUSEMOTION && previous.motion.windowID == current.motion.windowID && previous.motion.which == current.motion.which) {
+                int xrel = previous.motion.xrel + current.motion.xrel;
+                int yrel = previous.motion.yrel + current.motion.yrel;
+                previous.motion = current.motion;
+                previous.motion.xrel = xrel;
+                previous.motion.yrel = yrel;
+                continue;
+            }
+        }
+
+        events[kept++] = current;
     }
+
+    m_coalesced_count.fetch_add(events.size() - kept, std::memory_order_relaxed);
+    events.resize(kept);
 }
 
 void Event_queue::get_event(SDL_Event* event, bool &quit)
 {
-    // Verrouille le mutex pour protéger l'accès aux données partagées
-    std::unique_lock<std::mutex> lock(Event_Mutex::mtx);
     // Attend qu'un nouvel événement soit disponible ou que le programme soit en train de se terminer
-    while (!new_event_available && !quit)
-    {
-        cond_var.wait(lock);
-    }
-    // Si le programme est en train de se terminer, sort de la fonction
-    if (quit)
+    while (!quit)
     {
-        return;
+        // On lit la séquence avant d'essayer de dépiler pour ne pas rater un réveil
+        uint32_t sequence = m_events_sequence.load(std::memory_order_acquire);
+        if (m_events.pop(*event))
+            return;
+
+        m_events_sequence.wait(sequence, std::memory_order_acquire);
     }
-    // Indique qu'il n'y a plus de nouvel événement disponible
-    new_event_available = false;
-    // Récupère le dernier événement
-    *event = last_event;
+}
+
+size_t Event_queue::drain_events(std::span<SDL_Event> events)
+{
+    // Récupère d'un coup tous les événements disponibles (dans la limite de la taille de 'events')
+    return m_events.drain(events);
 }
 
 void Event_queue::notify_all() {
-    // Verrouille le mutex pour protéger l'accès aux données partagées
-    std::unique_lock<std::mutex> lock(Event_Mutex::mtx);
-    // Indique qu'un nouvel événement est disponible
-    new_event_available = true;
-    // Notifie tous les threads en attente qu'un nouvel événement est disponible
-    cond_var.notify_all();
+    // Réveille tous les threads en attente, par exemple pour qu'ils voient la demande d'arrêt
+    m_events_sequence.fetch_add(1, std::memory_order_release);
+    m_events_sequence.notify_all();
+    m_bus.notify_all();
+}
+
+std::shared_ptr<Event_subscriber> Event_queue::subscribe(Event_category categories, size_t capacity)
+{
+    // L'abonné ne recevra que les événements des catégories demandées
+    return m_bus.subscribe(categories, capacity);
 }
 
+void Event_queue::unsubscribe(const std::shared_ptr<Event_subscriber> &subscriber)
+{
+    m_bus.unsubscribe(subscriber);
+}
+
+void Event_queue::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    // À appeler avant de lancer le thread des événements
+    m_frame_invalidation = frame_invalidation;
+}
 
+void Event_queue::set_coalescing(bool merge_motion, bool keep_last_resize)
+{
+    // merge_motion : fusionne les mouvements de souris consécutifs
+    // keep_last_resize : ne garde que le dernier redimensionnement de chaque passage
+    m_merge_motion = merge_motion;
+    m_keep_last_resize = keep_last_resize;
+}
 
+size_t Event_queue::return_coalesced_count() const
+{
+    // Nombre total d'événements économisés par la fusion
+    return m_coalesced_count.load(std::memory_order_relaxed);
+}
+
+size_t Event_queue::return_capacity() const
+{
+    return m_events.return_capacity();
+}
+
+size_t Event_queue::return_overflow_count() const
+{
+    // Nombre d'événements perdus car la file était pleine
+    return m_events.return_overflow_count();
+}
@@ -6,25 +6,65 @@
 #define MEINCANVAS_EVENT_HPP
 
 
-#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
 #include <SDL2/SDL.h>
 
 #include "../main_prog/data.hpp"
+#include "event_ring.hpp"
+#include "event_bus.hpp"
+#include "../frame/frame_invalidation.hpp"
 
 
 class Event_queue {
 private:
-    SDL_Event last_event{};
-    bool new_event_available = false;
-    std::condition_variable cond_var;
+    // Tous les événements SDL sont conservés dans la file, plus aucun n'est écrasé
+    Event_ring<SDL_Event> m_events;
+
+    // Incrémenté à chaque nouvel arrivage, les consommateurs attendent dessus sans mutex
+    std::atomic<uint32_t> m_events_sequence = 0;
+
+    // Chaque abonné reçoit en plus sa propre copie des événements qui le concernent
+    Event_bus m_bus;
+
+    // Événements récupérés pendant un passage, fusionnés avant d'être publiés
+    std::vector<SDL_Event> m_poll_batch;
+    std::atomic<bool> m_merge_motion = true;
+    std::atomic<bool> m_keep_last_resize = true;
+    std::atomic<size_t> m_coalesced_count = 0;
+
+    // Type d'événement utilisateur qui sert uniquement à réveiller wait_events
+    Uint32 m_wake_up_event_type;
+
+    // Une entrée utilisateur invalide la frame pour que la boucle de rendu se réveille
+    Frame_invalidation *m_frame_invalidation = nullptr;
+
+private:
+    void coalesce_events(std::vector<SDL_Event> &events);
+    void publish_batch();
 
 public:
-    Event_queue() = default;
+    explicit Event_queue(size_t capacity = 1024);
     ~Event_queue() = default;
 
     void poll_events();
+    bool wait_events(int timeout_ms);
+    void wake_up();
     void get_event(SDL_Event* event, bool &quit);
+    size_t drain_events(std::span<SDL_Event> events);
     void notify_all();
+
+    std::shared_ptr<Event_subscriber> subscribe(Event_category categories, size_t capacity = 256);
+    void unsubscribe(const std::shared_ptr<Event_subscriber> &subscriber);
+
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+    void set_coalescing(bool merge_motion, bool keep_last_resize);
+    [[nodiscard]] size_t return_coalesced_count() const;
+
+    [[nodiscard]] size_t return_capacity() const;
+    [[nodiscard]] size_t return_overflow_count() const;
 };
 
 
@@ -0,0 +1,134 @@
+//
+// Created by dell_nicolas on 07/06/24.
+//
+
+#include "event_bus.hpp"
+
+#include <algorithm>
+#include <bit>
+
+
+Event_subscriber::Event_subscriber(Event_category categories, size_t capacity) : m_events(capacity), m_categories(categories) {}
+
+
+void Event_subscriber::push_event(const SDL_Event &event)
+{
+    // Si la file de l'abonné est pleine l'événement est compté comme perdu pour lui seul
+    if (m_events.push(event)) {
+        m_events_sequence.fetch_add(1, std::memory_order_release);
+        m_events_sequence.notify_all();
+    }
+}
+
+bool Event_subscriber::poll_event(SDL_Event *event)
+{
+    // Version non bloquante : renvoie false si aucun événement n'attend
+    return m_events.pop(*event);
+}
+
+void Event_subscriber::get_event(SDL_Event *event, bool &quit)
+{
+    // Attend le prochain événement de l'abonné ou la demande d'arrêt
+    while (!quit)
+    {
+        uint32_t sequence = m_events_sequence.load(std::memory_order_acquire);
+        if (m_events.pop(*event))
+            return;
+
+        m_events_sequence.wait(sequence, std::memory_order_acquire);
+    }
+}
+
+size_t Event_subscriber::drain_events(std::span<SDL_Event> events)
+{
+    return m_events.drain(events);
+}
+
+void Event_subscriber::notify()
+{
+    m_events_sequence.fetch_add(1, std::memory_order_release);
+    m_events_sequence.notify_all();
+}
+
+Event_category Event_subscriber::return_categories() const
+{
+    return m_categories;
+}
+
+size_t Event_subscriber::return_overflow_count() const
+{
+    return m_events.return_overflow_count();
+}
+
+
+std::shared_ptr<Event_subscriber> Event_bus::subscribe(Event_category categories, size_t capacity)
+{
+    auto subscriber = std::make_shared<Event_subscriber>(categories, capacity);
+
+    // On inscrit l'abonné dans la liste de chacune de ses catégories
+    std::lock_guard<std::mutex> lock(m_subscribers_mtx);
+    for (size_t i = 0; i < m_categories_count; i++)
+    {
+        if (categories & static_cast<Event_category>(1u << i))
+            m_subscribers[i].push_back(subscriber);
+    }
+
+    return subscriber;
+}
+
+void Event_bus::unsubscribe(const std::shared_ptr<Event_subscriber> &subscriber)
+{
+    std::lock_guard<std::mutex> lock(m_subscribers_mtx);
+    for (auto &subscribers : m_subscribers)
+        subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscriber), subscribers.end());
+}
+
+void Event_bus::publish(const SDL_Event &event)
+{
+    // On ne distribue l'événement qu'aux abonnés de sa catégorie
+    auto index = static_cast<size_t>(std::countr_zero(static_cast<uint32_t>(categorize(event))));
+
+    std::lock_guard<std::mutex> lock(m_subscribers_mtx);
+    for (auto &subscriber : m_subscribers[index])
+        subscriber->push_event(event);
+}
+
+void Event_bus::notify_all()
+{
+    // Réveille tous les abonnés en attente, par exemple pour qu'ils voient la demande d'arrêt
+    std::lock_guard<std::mutex> lock(m_subscribers_mtx);
+    for (auto &subscribers : m_subscribers)
+        for (auto &subscriber : subscribers)
+            subscriber->notify();
+}
+
+Event_category Event_bus::categorize(const SDL_Event &event)
+{
+    switch (event.type)
+    {
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            return Event_category::MOUSE_BUTTON;
+
+        case SDL_MOUSEMOTION:
+            return Event_category::MOUSE_MOTION;
+
+        case SDL_MOUSEWHEEL:
+            return Event_category::MOUSE_WHEEL;
+
+        case SDL_WINDOWEVENT:
+            return Event_category::WINDOW;
+
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_TEXTEDITING:
+        case SDL_TEXTINPUT:
+            return Event_category::KEYBOARD;
+
+        case SDL_QUIT:
+            return Event_category::QUIT;
+
+        default:
+            return Event_category::OTHER;
+    }
+}
@@ -0,0 +1,90 @@
+//
+// Created by dell_nicolas on 07/06/24.
+//
+
+#ifndef MEINCANVAS_EVENT_BUS_HPP
+#define MEINCANVAS_EVENT_BUS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include <SDL2/SDL.h>
+
+#include "event_ring.hpp"
+
+
+// Catégories d'événements auxquelles un abonné peut s'inscrire, combinables avec |
+enum class Event_category : uint32_t
+{
+    MOUSE_BUTTON = 1 << 0,
+    MOUSE_MOTION = 1 << 1,
+    MOUSE_WHEEL = 1 << 2,
+    WINDOW = 1 << 3,
+    KEYBOARD = 1 << 4,
+    QUIT = 1 << 5,
+    OTHER = 1 << 6,
+
+    ALL = (1 << 7) - 1
+};
+
+constexpr Event_category operator|(Event_category a, Event_category b)
+{
+    return static_cast<Event_category>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+
+constexpr bool operator&(Event_category a, Event_category b)
+{
+    return (static_cast<uint32_t>(a) & static_cast<uint32_t>(b)) != 0;
+}
+
+
+// File propre à un abonné, elle ne reçoit que les événements des catégories demandées
+class Event_subscriber {
+private:
+    Event_ring<SDL_Event> m_events;
+    std::atomic<uint32_t> m_events_sequence = 0;
+    Event_category m_categories;
+
+public:
+    Event_subscriber() = delete;
+    Event_subscriber(Event_category categories, size_t capacity);
+    ~Event_subscriber() = default;
+
+    void push_event(const SDL_Event &event);
+    bool poll_event(SDL_Event *event);
+    void get_event(SDL_Event *event, bool &quit);
+    size_t drain_events(std::span<SDL_Event> events);
+    void notify();
+
+    [[nodiscard]] Event_category return_categories() const;
+    [[nodiscard]] size_t return_overflow_count() const;
+};
+
+
+class Event_bus {
+private:
+    static constexpr size_t m_categories_count = 7;
+
+    // Les abonnés sont rangés par catégorie : publier un événement ne touche que les abonnés concernés
+    std::array<std::vector<std::shared_ptr<Event_subscriber>>, m_categories_count> m_subscribers;
+    std::mutex m_subscribers_mtx;
+
+public:
+    Event_bus() = default;
+    ~Event_bus() = default;
+
+    std::shared_ptr<Event_subscriber> subscribe(Event_category categories, size_t capacity = 256);
+    void unsubscribe(const std::shared_ptr<Event_subscriber> &subscriber);
+
+    void publish(const SDL_Event &event);
+    void notify_all();
+
+    static Event_category categorize(const SDL_Event &event);
+};
+
+
+#endif //MEINCANVAS_EVENT_BUS_HPP
@@ -0,0 +1,132 @@
+//
+// Created by dell_nicolas on 07/06/24.
+//
+
+#ifndef MEINCANVAS_EVENT_RING_HPP
+#define MEINCANVAS_EVENT_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+
+
+// File circulaire bornée sans verrou, plusieurs producteurs et plusieurs consommateurs
+// Chaque case porte un numéro de séquence qui indique si elle est libre pour le producteur ou prête pour le consommateur
+template <typename T>
+class Event_ring {
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    // Chaque index sur sa propre ligne de cache pour éviter le faux partage entre producteurs et consommateurs
+    alignas(64) std::atomic<size_t> m_enqueue_pos = 0;
+    alignas(64) std::atomic<size_t> m_dequeue_pos = 0;
+    alignas(64) std::atomic<size_t> m_overflow_count = 0;
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+
+private:
+    static size_t round_up_capacity(size_t capacity)
+    {
+        // La capacité est arrondie à la puissance de deux supérieure pour remplacer le modulo par un masque
+        size_t rounded = 2;
+        while (rounded < capacity)
+            rounded <<= 1;
+        return rounded;
+    }
+
+public:
+    Event_ring() = delete;
+    explicit Event_ring(size_t capacity) : m_mask(round_up_capacity(capacity) - 1)
+    {
+        m_cells = std::make_unique<Cell[]>(m_mask + 1);
+        for (size_t i = 0; i <= m_mask; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    Event_ring(const Event_ring&) = delete;
+    Event_ring& operator=(const Event_ring&) = delete;
+    ~Event_ring() = default;
+
+    bool push(const T &data)
+    {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = m_cells[pos & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+            // La case est libre : on essaie de la réserver
+            if (diff == 0)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.data = data;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // La case n'a pas encore été consommée : la file est pleine
+            else if (diff < 0)
+            {
+                m_overflow_count.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            // Un autre producteur nous a devancé, on recharge la position
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T &data)
+    {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = m_cells[pos & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+            // La case contient une donnée prête : on essaie de la prendre
+            if (diff == 0)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    data = cell.data;
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            // La case n'a pas encore été remplie : la file est vide
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t drain(std::span<T> out)
+    {
+        // Vide la file dans 'out' jusqu'à ce qu'elle soit vide ou que 'out' soit plein
+        size_t count = 0;
+        while (count < out.size() && pop(out[count]))
+            count++;
+        return count;
+    }
+
+    [[nodiscard]] size_t return_capacity() const { return m_mask + 1; }
+    [[nodiscard]] size_t return_overflow_count() const { return m_overflow_count.load(std::memory_order_relaxed); }
+};
+
+
+#endif //MEINCANVAS_EVENT_RING_HPP
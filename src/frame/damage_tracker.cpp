@@ -0,0 +1,172 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "damage_tracker.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+    bool overlap(const SDL_Rect &a, const SDL_Rect &b)
+    {
+        // Les rectangles qui se touchent sont aussi fusionnés
+        return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+    }
+
+    SDL_Rect unite(const SDL_Rect &a, const SDL_Rect &b)
+    {
+        int x = std::min(a.x, b.x), y = std::min(a.y, b.y);
+        return SDL_Rect{x, y, std::max(a.x + a.w, b.x + b.w) - x, std::max(a.y + a.h, b.y + b.h) - y};
+    }
+}
+
+
+void Damage_tracker::set_screen_size(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (width == m_width && height == m_height)
+        return;
+
+    m_width = width;
+    m_height = height;
+    m_full = true;
+}
+
+
+void Damage_tracker::set_always_full(bool always_full)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_always_full = always_full;
+}
+
+
+void Damage_tracker::add_damage(const SDL_Rect &rect)
+{
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (!m_full)
+        m_pending.push_back(rect);
+}
+
+
+void Damage_tracker::add_full_damage()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_full = true;
+    m_pending.clear();
+}
+
+
+void Damage_tracker::merge_rects(std::vector<SDL_Rect> &rects) const
+{
+    // On fusionne les rectangles qui se chevauchent jusqu'à ce qu'il n'y en ait plus
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < rects.size(); j++)
+            {
+                if (!overlap(rects[i], rects[j]))
+                    continue;
+
+                rects[i] = unite(rects[i], rects[j]);
+                rects[j] = rects.back();
+                rects.pop_back();
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    // Trop de zones : un seul rectangle englobant
+    if (rects.size() > m_max_rects)
+    {
+        SDL_Rect bounds = rects[0];
+        for (size_t i = 1; i < rects.size(); i++)
+            bounds = unite(bounds, rects[i]);
+        rects.assign(1, bounds);
+    }
+}
+
+
+bool Damage_tracker::take_frame_damage(std::vector<SDL_Rect> &rects)
+{
+    rects.clear();
+
+    bool full;
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        full = m_full || m_always_full;
+        width = m_width;
+        height = m_height;
+        if (!full)
+            rects.swap(m_pending);
+        m_pending.clear();
+        m_full = false;
+    }
+
+    // On limite les zones à l'écran
+    SDL_Rect screen{0, 0, width, height};
+    if (!full)
+    {
+        rects.erase(std::remove_if(rects.begin(), rects.end(), [&screen](SDL_Rect &rect) {
+            int x = std::max(rect.x, 0), y = std::max(rect.y, 0);
+            int w = std::min(rect.x + rect.w, screen.w) - x, h = std::min(rect.y + rect.h, screen.h) - y;
+            rect = SDL_Rect{x, y, w, h};
+            return w <= 0 || h <= 0;
+        }), rects.end());
+
+        merge_rects(rects);
+    }
+
+    uint64_t screen_area = uint64_t(std::max(width, 0)) * uint64_t(std::max(height, 0));
+    uint64_t area = 0;
+    for (const auto &rect : rects)
+        area += uint64_t(rect.w) * uint64_t(rect.h);
+
+    // La plus grande partie de l'écran est abîmée : autant tout redessiner en une passe
+    if (full || (screen_area > 0 && double(area) > m_full_ratio * double(screen_area)))
+    {
+        full = true;
+        rects.assign(1, screen);
+        area = screen_area;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (rects.empty())
+    {
+        m_statistics.skipped_frames++;
+        return false;
+    }
+
+    m_statistics.frames++;
+    if (full)
+        m_statistics.full_frames++;
+    m_statistics.last_rects = rects.size();
+    m_statistics.last_area = area;
+    m_statistics.last_ratio = screen_area > 0 ? double(area) / double(screen_area) : 1.0;
+    m_statistics.mean_ratio += (m_statistics.last_ratio - m_statistics.mean_ratio) / double(m_statistics.frames);
+
+    return full;
+}
+
+
+Damage_statistics Damage_tracker::return_statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_statistics;
+}
+
+
+void Damage_tracker::reset_statistics()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_statistics = Damage_statistics{};
+}
@@ -0,0 +1,74 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_DAMAGE_TRACKER_HPP
+#define MEINCANVAS_DAMAGE_TRACKER_HPP
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+struct Damage_statistics
+{
+    uint64_t frames = 0;            // Frames redessinées (au moins une zone abîmée)
+    uint64_t full_frames = 0;       // Dont frames redessinées en entier
+    uint64_t skipped_frames = 0;    // Frames sans aucune zone abîmée, rien n'est redessiné ni présenté
+
+    // Dernière frame redessinée
+    size_t last_rects = 0;
+    uint64_t last_area = 0;         // En pixels
+    double last_ratio = 0.0;        // Part de l'écran redessinée, entre 0 et 1
+
+    double mean_ratio = 0.0;        // Moyenne de last_ratio sur les frames redessinées
+};
+
+
+// Zones de l'écran qui ont changé depuis la dernière frame (vidéos, commandes de dessin, fenêtre)
+// Les composants ajoutent leurs zones depuis n'importe quel thread, la boucle de rendu les récupère une fois par frame
+class Damage_tracker {
+private:
+    mutable std::mutex m_mtx;
+    std::vector<SDL_Rect> m_pending;
+    bool m_full = true;             // La première frame est dessinée en entier
+    bool m_always_full = false;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    // Au-delà, on redessine tout l'écran : une seule passe coûte moins que beaucoup de petites
+    size_t m_max_rects = 8;
+    double m_full_ratio = 0.5;
+
+    Damage_statistics m_statistics;
+
+private:
+    void merge_rects(std::vector<SDL_Rect> &rects) const;
+
+public:
+    Damage_tracker() = default;
+    Damage_tracker(const Damage_tracker&) = delete;
+    Damage_tracker& operator=(const Damage_tracker&) = delete;
+    ~Damage_tracker() = default;
+
+    // Un changement de taille abîme tout l'écran
+    void set_screen_size(int width, int height);
+    // Pour les renderers dont le contenu n'est pas conservé d'une frame à l'autre (tout sauf le renderer logiciel)
+    void set_always_full(bool always_full);
+
+    void add_damage(const SDL_Rect &rect);
+    void add_full_damage();
+
+    // Zones à redessiner pour cette frame, fusionnées et limitées à l'écran, vide s'il n'y a rien à faire
+    // Renvoie true si c'est tout l'écran
+    bool take_frame_damage(std::vector<SDL_Rect> &rects);
+
+    [[nodiscard]] Damage_statistics return_statistics() const;
+    void reset_statistics();
+};
+
+
+#endif //MEINCANVAS_DAMAGE_TRACKER_HPP
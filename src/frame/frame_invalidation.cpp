@@ -0,0 +1,50 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "frame_invalidation.hpp"
+
+
+void Frame_invalidation::invalidate()
+{
+    // Peut être appelé depuis n'importe quel thread (callback vidéo, thread des événements, ...)
+    m_invalidations_count.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_dirty = true;
+    }
+    m_cond.notify_all();
+}
+
+
+bool Frame_invalidation::wait_for_invalidation(const bool &quit, std::chrono::steady_clock::time_point deadline)
+{
+    // On dort jusqu'à la prochaine invalidation, la demande d'arrêt ou l'échéance
+    // Renvoie true si la frame a été invalidée, false si on s'est réveillé pour l'échéance
+    std::unique_lock<std::mutex> lock(m_mtx);
+    return m_cond.wait_until(lock, deadline, [this, &quit]() { return m_dirty || quit; }) && m_dirty;
+}
+
+
+bool Frame_invalidation::consume()
+{
+    // On récupère l'état de la frame et on la remet à propre
+    std::lock_guard<std::mutex> lock(m_mtx);
+    bool dirty = m_dirty;
+    m_dirty = false;
+    return dirty;
+}
+
+
+void Frame_invalidation::wake_up()
+{
+    // Réveille la boucle sans invalider la frame, par exemple pour qu'elle voie la demande d'arrêt
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_cond.notify_all();
+}
+
+
+uint64_t Frame_invalidation::return_invalidations_count() const
+{
+    return m_invalidations_count.load(std::memory_order_relaxed);
+}
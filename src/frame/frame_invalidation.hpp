@@ -0,0 +1,40 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_FRAME_INVALIDATION_HPP
+#define MEINCANVAS_FRAME_INVALIDATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+
+// Indique à la boucle de rendu qu'il y a quelque chose de nouveau à afficher
+// Les composants (vidéos, entrées, dessin) marquent la frame comme sale, la boucle dort tant qu'elle est propre
+class Frame_invalidation {
+private:
+    bool m_dirty = true; // La première frame doit toujours être dessinée
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+
+    std::atomic<uint64_t> m_invalidations_count = 0;
+
+public:
+    Frame_invalidation() = default;
+    Frame_invalidation(const Frame_invalidation&) = delete;
+    Frame_invalidation& operator=(const Frame_invalidation&) = delete;
+    ~Frame_invalidation() = default;
+
+    void invalidate();
+    bool wait_for_invalidation(const bool &quit, std::chrono::steady_clock::time_point deadline);
+    bool consume();
+    void wake_up();
+
+    [[nodiscard]] uint64_t return_invalidations_count() const;
+};
+
+
+#endif //MEINCANVAS_FRAME_INVALIDATION_HPP
@@ -0,0 +1,132 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+
+Frame_pacer::Frame_pacer(double fps, std::chrono::microseconds spin_tail, Catch_up_policy policy)
+    : m_period(Clock::duration::zero()), m_spin_tail(spin_tail), m_policy(policy)
+{
+    set_fps(fps);
+}
+
+
+void Frame_pacer::set_fps(double fps)
+{
+    // La période est gardée en ticks de steady_clock : 120 fps donne bien 8.333 ms et pas 8 ms
+    if (fps > 0.0)
+        m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    m_started = false;
+}
+
+void Frame_pacer::set_spin_tail(std::chrono::microseconds spin_tail)
+{
+    // Temps passé à attendre activement juste avant l'échéance, pour une précision sous la milliseconde
+    m_spin_tail = spin_tail;
+}
+
+void Frame_pacer::set_catch_up_policy(Catch_up_policy policy)
+{
+    m_policy = policy;
+}
+
+
+void Frame_pacer::start()
+{
+    // La première échéance est une période après maintenant
+    m_deadline = Clock::now() + m_period;
+    m_started = true;
+}
+
+
+void Frame_pacer::wait()
+{
+    if (!m_started)
+        start();
+
+    Clock::time_point now = Clock::now();
+
+    // La frame a fini avant son échéance : on dort, puis on attend activement la fin si demandé
+    if (now < m_deadline)
+    {
+        if (m_deadline - now > m_spin_tail)
+            std::this_thread::sleep_until(m_deadline - m_spin_tail);
+
+        while ((now = Clock::now()) < m_deadline)
+            std::this_thread::yield();
+
+        record_jitter(now - m_deadline, false, 0);
+        m_deadline += m_period;
+        return;
+    }
+
+    // La frame a fini en retard
+    uint64_t missed = static_cast<uint64_t>((now - m_deadline) / m_period);
+    switch (m_policy)
+    {
+        case Catch_up_policy::CATCH_UP:
+            // On ne dort pas : les frames suivantes partent tout de suite jusqu'à rattraper la ligne de temps
+            // Au-delà de m_max_catch_up frames de retard on abandonne et on se recale
+            if (missed > m_max_catch_up)
+            {
+                record_jitter(now - m_deadline, true, missed);
+                m_deadline = now + m_period;
+            }
+            else
+            {
+                record_jitter(now - m_deadline, true, 0);
+                m_deadline += m_period;
+            }
+            break;
+
+        case Catch_up_policy::RESET:
+            record_jitter(now - m_deadline, true, missed);
+            m_deadline = now + m_period;
+            break;
+
+        case Catch_up_policy::SKIP_MISSED:
+        default:
+            // On garde la phase : prochaine échéance de la ligne de temps après maintenant
+            record_jitter(now - m_deadline, true, missed);
+            m_deadline += m_period * static_cast<Clock::rep>(missed + 1);
+            break;
+    }
+}
+
+
+void Frame_pacer::record_jitter(Clock::duration jitter, bool late, uint64_t skipped)
+{
+    double jitter_us = std::chrono::duration<double, std::micro>(jitter).count();
+
+    std::lock_guard<std::mutex> lock(m_statistics_mtx);
+    m_statistics.frames++;
+    if (late)
+        m_statistics.late_frames++;
+    m_statistics.skipped_frames += skipped;
+
+    // Moyenne et variance glissantes de Welford, sans garder d'historique
+    double delta = jitter_us - m_statistics.mean_us;
+    m_statistics.mean_us += delta / static_cast<double>(m_statistics.frames);
+    m_jitter_m2 += delta * (jitter_us - m_statistics.mean_us);
+    m_statistics.stddev_us = m_statistics.frames > 1 ? std::sqrt(m_jitter_m2 / static_cast<double>(m_statistics.frames - 1)) : 0.0;
+    m_statistics.max_us = std::max(m_statistics.max_us, jitter_us);
+}
+
+
+Jitter_statistics Frame_pacer::return_statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_statistics_mtx);
+    return m_statistics;
+}
+
+void Frame_pacer::reset_statistics()
+{
+    std::lock_guard<std::mutex> lock(m_statistics_mtx);
+    m_statistics = Jitter_statistics();
+    m_jitter_m2 = 0.0;
+}
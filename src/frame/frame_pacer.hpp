@@ -0,0 +1,74 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_FRAME_PACER_HPP
+#define MEINCANVAS_FRAME_PACER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+
+// Que faire quand une frame finit après son échéance
+enum class Catch_up_policy
+{
+    SKIP_MISSED,    // On saute les échéances ratées en gardant la même phase
+    CATCH_UP,       // On enchaîne les frames ratées sans attendre pour rattraper le retard
+    RESET           // On repart de maintenant (la ligne de temps dérive du retard)
+};
+
+struct Jitter_statistics
+{
+    uint64_t frames = 0;
+    uint64_t late_frames = 0;
+    uint64_t skipped_frames = 0;
+
+    // Écart entre le réveil effectif et l'échéance, en microsecondes
+    double mean_us = 0.0;
+    double stddev_us = 0.0;
+    double max_us = 0.0;
+};
+
+
+// Cadenceur de frames sur une ligne de temps absolue de steady_clock : les échéances sont
+// start + n * période, l'erreur de chaque sommeil ne s'accumule donc pas d'une frame à l'autre
+class Frame_pacer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::duration m_period;
+    Clock::duration m_spin_tail;
+    Catch_up_policy m_policy;
+
+    Clock::time_point m_deadline;
+    bool m_started = false;
+
+    // Nombre maximum de frames enchaînées en mode CATCH_UP avant de se recaler
+    uint64_t m_max_catch_up = 4;
+
+    Jitter_statistics m_statistics;
+    double m_jitter_m2 = 0.0;   // Somme des carrés des écarts (algorithme de Welford)
+    mutable std::mutex m_statistics_mtx;
+
+private:
+    void record_jitter(Clock::duration jitter, bool late, uint64_t skipped);
+
+public:
+    Frame_pacer() = delete;
+    explicit Frame_pacer(double fps, std::chrono::microseconds spin_tail = std::chrono::microseconds(0), Catch_up_policy policy = Catch_up_policy::SKIP_MISSED);
+    ~Frame_pacer() = default;
+
+    void start();
+    void wait();
+
+    void set_fps(double fps);
+    void set_spin_tail(std::chrono::microseconds spin_tail);
+    void set_catch_up_policy(Catch_up_policy policy);
+
+    [[nodiscard]] Jitter_statistics return_statistics() const;
+    void reset_statistics();
+};
+
+
+#endif //MEINCANVAS_FRAME_PACER_HPP
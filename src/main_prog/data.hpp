@@ -11,17 +11,29 @@
 #include <mutex>
 
 
+enum class Render_mode
+{
+    FIXED,      // On redessine à fps fixes
+    UNCAPPED,   // On redessine aussi vite que possible
+    ON_DEMAND   // On ne redessine que si la frame a été invalidée
+};
+
 struct Data
 {
     int window_width = 800;
     int window_height = 600;
 
+    // Cadence de la boucle de rendu
+    Render_mode render_mode = Render_mode::FIXED;
+    float render_fps = 120.0;
+
     const std::string prog_name = "Canvas";
 };
 
 enum class Command_option
 {
     NO_FPS_LIMIT,
+    ON_DEMAND_RENDER,
 
     NONE
 };
@@ -49,10 +61,6 @@ namespace Video_Mutex
 {
     extern std::mutex mtx;
 }
-namespace Event_Mutex
-{
-    extern std::mutex mtx;
-}
 namespace Button_Mutex
 {
     extern std::mutex mtx;
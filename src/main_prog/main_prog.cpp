@@ -19,8 +19,8 @@ namespace Mein_canvas {
         // On lance les threads
         set_up_main_workers();
 
-        // Exemple de chargement de vidéo
-        m_video->load_video_with_id("video", "b.mp4", {"--no-xlib", "--no-audio"});
+        // Exemple de chargement de vidéo, sans bloquer : elle apparaît à sa première image
+        m_video->load_video_async("video", "b.mp4", {0, 0, 0, 0}, {"--no-xlib", "--no-audio"});
 
         bool clicked = false;
         m_button_control->create_button_by_id("button", 0, 0, 100, 100, [this, &clicked]() {
@@ -38,36 +38,154 @@ namespace Mein_canvas {
             }
             m_video->edit_video_with_id("video", {0, 0, *m_window_width / 2, *m_window_height / 2});
             std::cout << m_video->get_number_of_video() << std::endl;
-            m_video->load_video_with_id("video2", "e.mkv");
+            m_video->load_video_async("video2", "e.mkv");
             std::cout << m_video->get_number_of_video() << std::endl;
             m_video->edit_video_with_id("video2", {*m_window_width / 2, *m_window_height / 2, *m_window_width / 2, *m_window_height / 2});
 
             clicked = true;
         });
 
-        // Boucle principale, on limite le nombre d'itérations par seconde a 120
-        limit_fps_of(m_quit, 120.0, [this]() {
-            if (m_event.type == SDL_QUIT)
+        // Boucle principale, sa cadence dépend du mode de rendu choisi
+        switch (m_common_data.render_mode)
+        {
+            case Render_mode::UNCAPPED:
+                limit_fps_of(m_quit, [this]() {
+                    render_frame();
+                });
+                break;
+
+            case Render_mode::ON_DEMAND:
+                // On dort jusqu'à ce qu'un composant invalide la frame, puis on redessine (au plus render_fps fois par seconde)
+                limit_fps_of(m_quit, *m_render_pacer, m_common_data.render_fps, [this]() {
+                    m_frame_invalidation->wait_for_invalidation(m_quit, std::chrono::steady_clock::now() + m_on_demand_timeout);
+                    m_frame_invalidation->consume();
+                    render_frame();
+                });
+                break;
+
+            case Render_mode::FIXED:
+            default:
+                // On limite le nombre d'itérations par seconde a render_fps (120 par défaut)
+                limit_fps_of(m_quit, *m_render_pacer, m_common_data.render_fps, [this]() {
+                    render_frame();
+                });
+                break;
+        }
+
+        // On réveille le superviseur des workers et le thread des événements pour qu'ils voient la demande d'arrêt
+        m_threads_workers->wake_up();
+        m_event_control->wake_up();
+
+        // On stoppe les vidéos
+        m_video->stop_all_video();
+    }
+
+
+    void Main_prog::render_frame()
+    {
+        // On traite tous les événements de fenêtre reçus depuis la frame précédente
+        SDL_Event window_event;
+        while (m_window_events->poll_event(&window_event))
+        {
+            if (window_event.type == SDL_QUIT)
             {
                 std::lock_guard<std::mutex> lock(Quit_Mutex::mtx);
                 m_quit = true;
             } else {
+                // Redimensionnement, fenêtre découverte, ... : tout l'écran est à redessiner
                 SDL_GetWindowSize(m_prog_window, m_window_width, m_window_height);
+                m_damage_tracker->add_full_damage();
             }
+        }
 
-            SDL_RenderClear(m_renderer);
+        // Callbacks de boutons qui doivent s'exécuter sur le thread principal
+        m_button_control->run_main_thread_callbacks();
+
+        // On lance les jobs de la frame, ils tournent dans le pool pendant qu'on dessine
+        m_threads_workers->launch_frame_jobs();
+
+        // Vidéos dont l'analyse est terminée : leur texture et leur lecteur sont créés ici, sur le thread du renderer
+        m_video->update_loading_videos();
+        // Dernières images décodées vers leur texture, le décodeur n'attend jamais le rendu
+        m_video->update_video_frames();
+
+        // Taille de sortie de la frame, le framebuffer logiciel la suit
+        int output_width = 0, output_height = 0;
+        SDL_GetRendererOutputSize(m_renderer, &output_width, &output_height);
+        m_draw_on_window->begin_frame(output_width, output_height);
 
-            // On affiche les vidéos
-            m_video->display_video_all_video();
+        // Code de dessin ici, les primitives sont seulement mises en file (ou dessinées en mémoire en mode framebuffer)
+        display_on_screen();
 
-            // Code de dessin ici
-            display_on_screen();
+        // On rassemble les zones abîmées depuis la frame précédente (vidéos, commandes de dessin, fenêtre)
+        m_damage_tracker->set_screen_size(output_width, output_height);
+        m_draw_on_window->collect_damage(*m_damage_tracker);
+        bool full_damage = m_damage_tracker->take_frame_damage(m_frame_damage);
 
+        // On n'efface et ne recompose que les zones abîmées, le reste de l'image est conservé par le renderer logiciel
+        if (!m_frame_damage.empty())
+        {
+            m_draw_on_window->prepare();
+            for (const auto &damage : m_frame_damage)
+            {
+                // SDL_RenderClear ignore le clip, une zone partielle est effacée avec la couleur de fond
+                SDL_RenderSetClipRect(m_renderer, full_damage ? nullptr : &damage);
+                m_draw_on_window->draw_background(full_damage ? nullptr : &damage);
+
+                // On affiche les vidéos
+                m_video->display_video_all_video();
+
+                // La liste d'affichage retenue puis les primitives mises en file partent en quelques appels groupés
+                m_draw_on_window->composite();
+            }
+            SDL_RenderSetClipRect(m_renderer, nullptr);
+        }
+        m_draw_on_window->end_frame();
+
+        // Tous les jobs de la frame doivent être terminés avant l'affichage
+        m_threads_workers->wait_frame_jobs();
+
+        // Rien n'a changé : l'image à l'écran est déjà la bonne
+        if (!m_frame_damage.empty())
             SDL_RenderPresent(m_renderer);
-        });
+    }
 
-        // On stoppe les vidéos
-        m_video->stop_all_video();
+
+    void Main_prog::set_render_mode(Render_mode mode, float fps)
+    {
+        // A appeler avant run()
+        m_common_data.render_mode = mode;
+        m_common_data.render_fps = fps;
+        m_render_pacer->set_fps(fps);
+    }
+
+
+    Jitter_statistics Main_prog::return_render_statistics() const
+    {
+        // Statistiques de régularité des frames de la boucle principale
+        return m_render_pacer->return_statistics();
+    }
+
+
+    Damage_statistics Main_prog::return_damage_statistics() const
+    {
+        // Part de l'écran recomposée par frame
+        return m_damage_tracker->return_statistics();
+    }
+
+
+    void Main_prog::set_framebuffer_mode(bool enabled)
+    {
+        m_draw_on_window->set_framebuffer_mode(enabled);
+        invalidate_frame();
+    }
+
+
+    void Main_prog::invalidate_frame()
+    {
+        // Demande à la boucle de rendu de redessiner entièrement la prochaine frame
+        m_damage_tracker->add_full_damage();
+        m_frame_invalidation->invalidate();
     }
 
 
@@ -89,35 +207,38 @@ namespace Mein_canvas {
     void Main_prog::set_up_main_workers()
     {
         // Thread Event qui gère les événements
+        // Il dort tant qu'aucun événement n'arrive, wake_up le réveille pour l'arrêt
+        // Il boucle jusqu'à l'arrêt : long_running, il a son propre thread et ne prend rien au pool
         m_threads_workers->create_worker_by_id("event", [this]() {
             pthread_setname_np(pthread_self(), "prog-event");
-            limit_fps_of(m_quit, 512.0, [this]() {
-                m_event_control->poll_events();
-            });
-        }, true, false);
-
-        // Thread Event qui recupère les événements
-        m_threads_workers->create_worker_by_id("event2", [this]() {
-            pthread_setname_np(pthread_self(), "prog-event2");
-            limit_fps_of(m_quit, 512.0, [this]() {
-                m_event_control->get_event(&m_event, m_quit);
-            });
-        }, true, false);
-
-        // Thread Event update les boutons
-        m_threads_workers->create_worker_by_id("refresh-buttons", [this]() {
-            pthread_setname_np(pthread_self(), "prog-buttons");
-            limit_fps_of(m_quit, 120.0, [this]() {
-                m_button_control->check_all_buttons_clicked();
-            });
-        }, true, false);
+            std::array<SDL_Event, 64> events{};
+            while (!m_quit) {
+                if (!m_event_control->wait_events(250))
+                    continue;
+
+                // Les événements publiés sont récupérés ici, sans thread dédié qui tourne à 512 Hz
+                // m_event garde le dernier pour la souris, les abonnés du bus ont déjà reçu les leurs
+                size_t count;
+                while ((count = m_event_control->drain_events(events)) > 0)
+                    m_event = events[count - 1];
+            }
+        }, true, false, true);
+
+        // Tâche périodique qui update les boutons
+        m_threads_workers->create_periodic_task_by_id("refresh-buttons", 120.0, [this]() {
+            m_button_control->check_all_buttons_clicked();
+        });
 
         // Thread principal des workers, il lance les autres workers
+        // Il dort tant qu'aucun worker ne s'est terminé et que la liste des workers n'a pas changé
         std::thread run_worker_thread([this]() {
             pthread_setname_np(pthread_self(), "prog-workers");
-            limit_fps_of(m_quit, 512.0, [this]() {
+            m_threads_workers->run_workers();
+            while (!m_quit)
+            {
+                m_threads_workers->wait_for_changes(m_quit);
                 m_threads_workers->run_workers();
-            });
+            }
 
             m_threads_workers->quit_all_threads();
         });
@@ -125,8 +246,14 @@ namespace Mein_canvas {
     }
 
 
-    Main_prog::Main_prog()
+    Main_prog::Main_prog(Command_option option)
     {
+        // Choix de la cadence de rendu
+        if (option == Command_option::NO_FPS_LIMIT)
+            m_common_data.render_mode = Render_mode::UNCAPPED;
+        else if (option == Command_option::ON_DEMAND_RENDER)
+            m_common_data.render_mode = Render_mode::ON_DEMAND;
+
         // Initialisation des variables
         m_window_width = &m_common_data.window_width;
         m_window_height = &m_common_data.window_height;
@@ -136,6 +263,10 @@ namespace Mein_canvas {
         if (SDL_Init(SDL_INIT_VIDEO) != 0)      // SDL init_prog_var
             get_error("Erreur lors de l'initialisation de SDL : ", SDL_GetError(), -1);
 
+        // Le texte est optionnel, sans SDL_ttf le reste du programme fonctionne
+        if (TTF_Init() != 0)
+            std::cout << "Erreur lors de l'initialisation de SDL_ttf : " << TTF_GetError() << std::endl;
+
         // Passe le format du nom de la fenetre de std::string a const char *
         m_prog_window = SDL_CreateWindow(m_prog_name->c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                          *m_window_width, *m_window_height,
@@ -152,12 +283,34 @@ namespace Mein_canvas {
         }
 
         // Initialisation des classes
+        m_frame_invalidation = std::make_unique<Frame_invalidation>();
+        m_damage_tracker = std::make_unique<Damage_tracker>();
+
+        // Le contenu de la cible n'est conservé d'une frame à l'autre qu'avec le renderer logiciel,
+        // avec les autres on recompose tout l'écran à chaque frame
+        SDL_RendererInfo renderer_info;
+        if (SDL_GetRendererInfo(m_renderer, &renderer_info) != 0 || !(renderer_info.flags & SDL_RENDERER_SOFTWARE))
+            m_damage_tracker->set_always_full(true);
+        // Un court temps d'attente active avant chaque échéance donne une cadence précise à la microseconde près
+        m_render_pacer = std::make_unique<Frame_pacer>(m_common_data.render_fps, std::chrono::microseconds(250));
         m_event_control = std::make_unique<Event_queue>();
+        m_event_control->set_frame_invalidation(m_frame_invalidation.get());
+        m_window_events = m_event_control->subscribe(Event_category::QUIT | Event_category::WINDOW);
         m_draw_on_window = std::make_unique<Draw_on_screen>(m_renderer, &m_rect, m_window_width, m_window_height);
+        m_draw_on_window->set_frame_invalidation(m_frame_invalidation.get());
         m_mouse_control = std::make_unique<Mouse>(&m_event);
-        m_button_control = std::make_unique<Buttons>(&m_mouse_control, m_window_width, m_window_height);
+        m_button_control = std::make_unique<Buttons>(&m_mouse_control, m_event_control->subscribe(Event_category::MOUSE_BUTTON), m_window_width, m_window_height);
         m_threads_workers = std::make_unique<ThreadsWorkers>();
+        // Les tuiles du framebuffer logiciel sont rastérisées dans le pool
+        m_draw_on_window->set_threads_workers(m_threads_workers.get());
+        m_button_control->set_frame_invalidation(m_frame_invalidation.get());
+        m_button_control->set_callback_executor([this](std::function<void()> callback) {
+            m_threads_workers->submit_task(std::move(callback));
+        });
         m_video = std::make_unique<Video>(m_renderer);
+        m_video->set_frame_invalidation(m_frame_invalidation.get());
+        m_video->set_damage_tracker(m_damage_tracker.get());
+        m_video->set_threads_workers(m_threads_workers.get());
 
 
         m_quit = false;  // Init de la variable qui permet de quitter le programme, une fois a "true" la boucle while principale se coupe et le programme s'arrete
@@ -172,6 +325,9 @@ namespace Mein_canvas {
         // On clear le render
         if (m_renderer)
         {
+            // Les textures de la liste d'affichage doivent être détruites avant leur renderer
+            m_draw_on_window.reset();
+
             SDL_RenderClear(m_renderer);
             SDL_DestroyRenderer(m_renderer);
             m_renderer = nullptr;
@@ -183,36 +339,30 @@ namespace Mein_canvas {
             m_prog_window = nullptr;
         }
 
+        // Les polices sont fermées avec m_draw_on_window, avant l'arrêt de SDL_ttf
+        m_draw_on_window.reset();
+        if (TTF_WasInit())
+            TTF_Quit();
+
         SDL_Quit();
     }
 
 
     void Main_prog::limit_fps_of(bool &quit, float fps, const std::function<void()> &function) {
-        // Calcul du délai entre chaque frame en millisecondes
-        auto delay = std::chrono::milliseconds(static_cast<long>(1000.0 / fps));
+        // Cadenceur local, les échéances sont calculées sur une ligne de temps absolue
+        Frame_pacer pacer(fps);
+        limit_fps_of(quit, pacer, fps, function);
+    }
 
+    void Main_prog::limit_fps_of(bool &quit, Frame_pacer &pacer, float fps, const std::function<void()> &function) {
         // Boucle principale
+        pacer.start();
         while (!quit && fps > 0.0) {
-            //
-            // Cette partie de code permet de calculer le nombre d'iteration par seconde
-            // Et de limiter le nombre d'iteration par seconde a 120
-            auto start = std::chrono::high_resolution_clock::now();
-
-
             // Exécution de la fonction
             function();
 
-
-            // Enregistrement du moment de fin
-            auto end = std::chrono::high_resolution_clock::now();
-
-            // Calcul du temps écoulé
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-
-            // Si le temps écoulé est inférieur au délai, on fait une pause pour atteindre le délai
-            if (elapsed < delay) {
-                std::this_thread::sleep_for(delay - elapsed);
-            }
+            // On dort jusqu'à l'échéance suivante (et pas "délai moins temps écoulé"), l'erreur ne s'accumule pas
+            pacer.wait();
         }
 
         while (!quit && fps < 0.0) {
@@ -5,6 +5,7 @@
 
 #include <SDL2/SDL.h>
 
+#include <array>
 #include <iostream>
 #include <thread>
 #include <memory>
@@ -16,6 +17,9 @@
 #include "../threads_workers/threads_workers.hpp"
 #include "../event_handler_for_multi_threads/event.hpp"
 #include "../video/video.hpp"
+#include "../frame/frame_invalidation.hpp"
+#include "../frame/frame_pacer.hpp"
+#include "../frame/damage_tracker.hpp"
 
 namespace Mein_canvas {
 
@@ -36,6 +40,12 @@ namespace Mein_canvas {
 
         Data m_common_data;
 
+        // Déclarée en premier pour être détruite en dernier, les autres composants l'utilisent
+        std::unique_ptr<Frame_invalidation> m_frame_invalidation;
+        // Zones de l'écran à recomposer, les vidéos y écrivent depuis les threads de VLC
+        std::unique_ptr<Damage_tracker> m_damage_tracker;
+        std::vector<SDL_Rect> m_frame_damage;
+
         std::unique_ptr<Event_queue> m_event_control;
         std::unique_ptr<Draw_on_screen> m_draw_on_window;
         std::unique_ptr<Mouse> m_mouse_control;
@@ -43,19 +53,35 @@ namespace Mein_canvas {
         std::unique_ptr<ThreadsWorkers> m_threads_workers;
         std::unique_ptr<Video> m_video;
 
+        std::unique_ptr<Frame_pacer> m_render_pacer;
+
+        // En mode ON_DEMAND, on redessine quand même après ce délai sans invalidation
+        std::chrono::milliseconds m_on_demand_timeout{1000};
+
+        // Événements de fenêtre et de fermeture destinés à la boucle principale
+        std::shared_ptr<Event_subscriber> m_window_events;
+
     private:
         static void limit_fps_of(bool &quit, float fps, const std::function<void()> &function);
         static void limit_fps_of(bool &quit, const std::function<void()> &function);
+        static void limit_fps_of(bool &quit, Frame_pacer &pacer, float fps, const std::function<void()> &function);
 
         static void get_error(const std::string &error, const std::string &error_log, int code);
 
         void display_on_screen();
+        void render_frame();
         void set_up_main_workers();
 
     public:
-        Main_prog();
+        explicit Main_prog(Command_option option = Command_option::NONE);
 
         void run();
+        void set_render_mode(Render_mode mode, float fps = 120.0);
+        void invalidate_frame();
+        // Primitives immédiates dessinées en mémoire par les noyaux SIMD, à activer avant run()
+        void set_framebuffer_mode(bool enabled);
+        [[nodiscard]] Jitter_statistics return_render_statistics() const;
+        [[nodiscard]] Damage_statistics return_damage_statistics() const;
 
         ~Main_prog();
 
@@ -0,0 +1,186 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_REGISTRY_HPP
+#define MEINCANVAS_REGISTRY_HPP
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+// Poignée vers un objet d'un Registry : index de la case + génération de la case
+// Quand la case est libérée puis réutilisée sa génération change, les anciennes poignées deviennent invalides
+struct Handle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    [[nodiscard]] bool is_valid() const { return index != UINT32_MAX; }
+    [[nodiscard]] uint64_t to_key() const { return (static_cast<uint64_t>(index) << 32) | generation; }
+    static Handle from_key(uint64_t key) { return Handle{static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key)}; }
+
+    bool operator==(const Handle &other) const = default;
+};
+
+
+// Table à cases (slot map) : insertion, suppression et accès en O(1) par poignée
+// Les cases sont dans un std::deque, un objet ne bouge donc jamais en mémoire tant qu'il existe
+// Le nom (ancien id texte) n'est plus qu'un index optionnel vers la poignée
+// Pas de verrou ici, c'est au propriétaire de protéger l'accès (Button_Mutex, Video_Mutex, ...)
+template <typename T>
+class Registry {
+private:
+    struct Slot {
+        std::optional<T> value;
+        uint32_t generation = 0;
+        std::string name;
+    };
+
+    std::deque<Slot> m_slots;
+    std::vector<uint32_t> m_free_slots;
+    std::unordered_map<std::string, Handle> m_names;
+    size_t m_size = 0;
+
+public:
+    Registry() = default;
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+    ~Registry() = default;
+
+    Handle insert(T value, const std::string &name = "")
+    {
+        // Un nom ne peut désigner qu'un seul objet
+        if (!name.empty() && m_names.find(name) != m_names.end())
+            return Handle{};
+
+        // On réutilise une case libre si possible, sinon on en ajoute une
+        uint32_t index;
+        if (!m_free_slots.empty()) {
+            index = m_free_slots.back();
+            m_free_slots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(m_slots.size());
+            m_slots.emplace_back();
+        }
+
+        Slot &slot = m_slots[index];
+        slot.value.emplace(std::move(value));
+        slot.name = name;
+
+        Handle handle{index, slot.generation};
+        if (!name.empty())
+            m_names[name] = handle;
+        m_size++;
+
+        return handle;
+    }
+
+    bool erase(Handle handle)
+    {
+        T *value = get(handle);
+        if (!value)
+            return false;
+
+        // La génération change : toutes les poignées vers cette case deviennent invalides
+        Slot &slot = m_slots[handle.index];
+        if (!slot.name.empty())
+            m_names.erase(slot.name);
+        slot.name.clear();
+        slot.value.reset();
+        slot.generation++;
+        m_free_slots.push_back(handle.index);
+        m_size--;
+
+        return true;
+    }
+
+    bool erase(const std::string &name)
+    {
+        return erase(find(name));
+    }
+
+    std::optional<T> take(Handle handle)
+    {
+        // Comme erase, mais rend l'objet à l'appelant (pour le détruire hors d'un verrou par exemple)
+        T *value = get(handle);
+        if (!value)
+            return std::nullopt;
+
+        std::optional<T> taken(std::move(*value));
+        erase(handle);
+        return taken;
+    }
+
+    [[nodiscard]] T *get(Handle handle)
+    {
+        if (handle.index >= m_slots.size())
+            return nullptr;
+
+        Slot &slot = m_slots[handle.index];
+        if (slot.generation != handle.generation || !slot.value)
+            return nullptr;
+
+        return &*slot.value;
+    }
+
+    [[nodiscard]] const T *get(Handle handle) const
+    {
+        return const_cast<Registry *>(this)->get(handle);
+    }
+
+    [[nodiscard]] T *get(const std::string &name)
+    {
+        return get(find(name));
+    }
+
+    [[nodiscard]] Handle find(const std::string &name) const
+    {
+        auto it = m_names.find(name);
+        return it != m_names.end() ? it->second : Handle{};
+    }
+
+    [[nodiscard]] const std::string &return_name(Handle handle) const
+    {
+        static const std::string empty;
+        return get(handle) ? m_slots[handle.index].name : empty;
+    }
+
+    // Appelle function(handle, objet) pour chaque objet vivant
+    template <typename Function>
+    void for_each(Function &&function)
+    {
+        for (uint32_t i = 0; i < m_slots.size(); i++) {
+            if (m_slots[i].value)
+                function(Handle{i, m_slots[i].generation}, *m_slots[i].value);
+        }
+    }
+
+    template <typename Function>
+    void for_each(Function &&function) const
+    {
+        for (uint32_t i = 0; i < m_slots.size(); i++) {
+            if (m_slots[i].value)
+                function(Handle{i, m_slots[i].generation}, *m_slots[i].value);
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return m_size; }
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+
+    void clear()
+    {
+        for (uint32_t i = 0; i < m_slots.size(); i++) {
+            if (m_slots[i].value)
+                erase(Handle{i, m_slots[i].generation});
+        }
+    }
+};
+
+
+#endif //MEINCANVAS_REGISTRY_HPP
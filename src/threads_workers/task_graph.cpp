@@ -0,0 +1,211 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "task_graph.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+
+Task_graph::Task_graph(Thread_pool *pool) : m_pool(pool) {}
+
+
+long Task_graph::find_job_index(const std::string &id) const
+{
+    auto it = std::find_if(m_jobs.begin(), m_jobs.end(), [&id](const std::unique_ptr<Job>& job){return job->id == id;});
+    return it != m_jobs.end() ? std::distance(m_jobs.begin(), it) : -1;
+}
+
+
+bool Task_graph::create_job_by_id(const std::string &id, std::function<void()> work, const std::vector<std::string> &dependencies)
+{
+    // On ne modifie pas le graphe pendant qu'une frame s'exécute, mais on ne l'attend pas non plus :
+    // un job (ou le thread qui va attendre la frame) qui ajoute un job se bloquerait lui-même
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_frame_running)
+    {
+        m_pending_changes.push_back(Pending_change{true, id, std::move(work), dependencies});
+        return true;
+    }
+
+    return apply_create_job(id, std::move(work), dependencies);
+}
+
+
+bool Task_graph::delete_job_by_id(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (m_frame_running)
+    {
+        m_pending_changes.push_back(Pending_change{false, id, {}, {}});
+        return true;
+    }
+
+    return apply_delete_job(id);
+}
+
+
+void Task_graph::apply_pending_changes()
+{
+    // Sous m_mtx, dernier job de la frame terminé : les modifications sont appliquées dans l'ordre des demandes
+    std::vector<Pending_change> changes;
+    changes.swap(m_pending_changes);
+    for (auto &change : changes)
+    {
+        if (change.create)
+            apply_create_job(change.id, std::move(change.work), change.dependencies);
+        else
+            apply_delete_job(change.id);
+    }
+}
+
+
+bool Task_graph::apply_create_job(const std::string &id, std::function<void()> work, const std::vector<std::string> &dependencies)
+{
+    if (find_job_index(id) != -1)
+    {
+        std::cout << "Job " << id << " already exists" << std::endl;
+        return false;
+    }
+
+    // Les dépendances doivent déjà exister : le graphe reste ainsi forcément sans cycle
+    std::vector<size_t> dependencies_index;
+    for (const auto &dependency : dependencies)
+    {
+        long index = find_job_index(dependency);
+        if (index == -1)
+        {
+            std::cout << "Job " << id << " depends on unknown job " << dependency << std::endl;
+            return false;
+        }
+        dependencies_index.push_back(static_cast<size_t>(index));
+    }
+
+    auto job = std::make_unique<Job>();
+    job->id = id;
+    job->work = std::move(work);
+    job->dependencies = dependencies_index;
+
+    size_t new_index = m_jobs.size();
+    for (size_t dependency : dependencies_index)
+        m_jobs[dependency]->dependents.push_back(new_index);
+
+    m_jobs.push_back(std::move(job));
+    return true;
+}
+
+
+bool Task_graph::apply_delete_job(const std::string &id)
+{
+    long index = find_job_index(id);
+    if (index == -1)
+        return false;
+
+    // On refuse de supprimer un job dont d'autres dépendent
+    if (!m_jobs[index]->dependents.empty())
+    {
+        std::cout << "Job " << id << " is still needed by " << m_jobs[index]->dependents.size() << " job(s)" << std::endl;
+        return false;
+    }
+
+    // On retire le job des listes de ses dépendances puis on décale les index suivants
+    for (size_t dependency : m_jobs[index]->dependencies)
+    {
+        auto &dependents = m_jobs[dependency]->dependents;
+        dependents.erase(std::remove(dependents.begin(), dependents.end(), static_cast<size_t>(index)), dependents.end());
+    }
+    m_jobs.erase(m_jobs.begin() + index);
+
+    for (auto &job : m_jobs)
+    {
+        for (auto &dependency : job->dependencies)
+            if (dependency > static_cast<size_t>(index)) dependency--;
+        for (auto &dependent : job->dependents)
+            if (dependent > static_cast<size_t>(index)) dependent--;
+    }
+
+    return true;
+}
+
+
+unsigned int Task_graph::return_jobs_size()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return static_cast<unsigned int>(m_jobs.size());
+}
+
+
+bool Task_graph::launch_frame()
+{
+    std::vector<size_t> ready_jobs;
+    {
+        // Une seule frame à la fois, la précédente doit avoir été attendue
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_frame_running || m_jobs.empty())
+            return false;
+
+        m_frame_running = true;
+        m_remaining_jobs = m_jobs.size();
+
+        // On réarme les compteurs de dépendances, les jobs sans dépendance sont prêts tout de suite
+        for (size_t i = 0; i < m_jobs.size(); i++)
+        {
+            m_jobs[i]->remaining_dependencies = m_jobs[i]->dependencies.size();
+            if (m_jobs[i]->dependencies.empty())
+                ready_jobs.push_back(i);
+        }
+    }
+
+    for (size_t index : ready_jobs)
+        submit_job(index);
+
+    return true;
+}
+
+
+void Task_graph::submit_job(size_t index)
+{
+    m_pool->submit([this, index]() {
+        try {
+            m_jobs[index]->work();
+        } catch (const std::exception &e) {
+            std::cout << "Job " << m_jobs[index]->id << " failed : " << e.what() << std::endl;
+        }
+        job_finished(index);
+    });
+}
+
+
+void Task_graph::job_finished(size_t index)
+{
+    // Les jobs qui n'attendaient plus que celui-ci deviennent prêts
+    for (size_t dependent : m_jobs[index]->dependents)
+    {
+        if (--m_jobs[dependent]->remaining_dependencies == 0)
+            submit_job(dependent);
+    }
+
+    // On notifie sous le mutex : dès la barrière franchie, le graphe peut être détruit
+    std::lock_guard<std::mutex> lock(m_mtx);
+    if (--m_remaining_jobs != 0)
+        return;
+    apply_pending_changes();
+    m_frame_running = false;
+    m_frame_cond.notify_all();
+}
+
+
+void Task_graph::wait_frame()
+{
+    // Barrière de fin de frame : on attend que tous les jobs lancés soient terminés
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_frame_cond.wait(lock, [this]() { return !m_frame_running; });
+}
+
+
+Task_graph::~Task_graph()
+{
+    // Les jobs en cours référencent le graphe, on attend leur fin
+    wait_frame();
+}
@@ -0,0 +1,75 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_TASK_GRAPH_HPP
+#define MEINCANVAS_TASK_GRAPH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+
+// Graphe de jobs exécuté une fois par frame : un job ne démarre que lorsque toutes ses dépendances sont terminées
+// Les jobs prêts en même temps tournent en parallèle dans le pool, la barrière wait_frame attend la fin de tous les jobs
+class Task_graph {
+private:
+    struct Job {
+        std::string id;
+        std::function<void()> work;
+        std::vector<size_t> dependencies;
+        std::vector<size_t> dependents;
+        std::atomic<size_t> remaining_dependencies = 0;
+    };
+
+    // Ajout ou suppression demandé pendant une frame (par un job, un worker, ...) : appliqué à la fin de la frame
+    struct Pending_change {
+        bool create;
+        std::string id;
+        std::function<void()> work;
+        std::vector<std::string> dependencies;
+    };
+
+    std::vector<std::unique_ptr<Job>> m_jobs;
+    std::vector<Pending_change> m_pending_changes;
+    Thread_pool *m_pool;
+
+    std::mutex m_mtx;
+    std::condition_variable m_frame_cond;
+    size_t m_remaining_jobs = 0;
+    bool m_frame_running = false;
+
+private:
+    void submit_job(size_t index);
+    void job_finished(size_t index);
+    [[nodiscard]] long find_job_index(const std::string &id) const;
+    bool apply_create_job(const std::string &id, std::function<void()> work, const std::vector<std::string> &dependencies);
+    bool apply_delete_job(const std::string &id);
+    void apply_pending_changes();
+
+public:
+    Task_graph() = delete;
+    explicit Task_graph(Thread_pool *pool);
+    Task_graph(const Task_graph&) = delete;
+    Task_graph& operator=(const Task_graph&) = delete;
+
+    // Pendant une frame, la modification est gardée pour la fin de la frame et true est renvoyé sans attendre :
+    // ses erreurs (id déjà pris, dépendance inconnue, ...) ne sont alors qu'affichées
+    bool create_job_by_id(const std::string &id, std::function<void()> work, const std::vector<std::string> &dependencies = {});
+    bool delete_job_by_id(const std::string &id);
+    [[nodiscard]] unsigned int return_jobs_size();
+
+    bool launch_frame();
+    void wait_frame();
+
+    ~Task_graph();
+};
+
+
+#endif //MEINCANVAS_TASK_GRAPH_HPP
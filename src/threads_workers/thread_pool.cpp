@@ -0,0 +1,183 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+
+Thread_pool::Thread_pool(unsigned int threads_count)
+{
+    // Au moins un thread, sinon aucune tâche ne serait jamais exécutée
+    if (threads_count == 0)
+        threads_count = 1;
+
+    // Une file par thread, créées avant les threads pour que le vol soit toujours possible
+    for (unsigned int i = 0; i < threads_count; i++)
+        m_queues.push_back(std::make_unique<Work_queue>());
+
+    for (unsigned int i = 0; i < threads_count; i++)
+    {
+        m_threads.emplace_back([this, i]() {
+            pthread_setname_np(pthread_self(), ("prog-pool-" + std::to_string(i)).substr(0, 15).c_str());
+            worker_loop(i);
+        });
+    }
+}
+
+
+std::future<void> Thread_pool::submit(std::function<void()> work)
+{
+    // On emballe le travail pour que l'appelant puisse savoir quand il est terminé
+    auto task = std::make_shared<std::packaged_task<void()>>(std::move(work));
+    std::future<void> future = task->get_future();
+
+    {
+        // On incrémente avant de déposer la tâche, et sous le mutex de sommeil pour ne pas perdre de réveil
+        std::lock_guard<std::mutex> lock(m_sleep_mtx);
+        m_pending_tasks++;
+    }
+
+    // Répartition en tourniquet sur les files des threads, les threads inactifs voleront le surplus
+    unsigned int index = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mtx);
+        m_queues[index]->tasks.emplace_back([task]() { (*task)(); });
+    }
+    m_sleep_cond.notify_one();
+
+    return future;
+}
+
+
+void Thread_pool::parallel_for(size_t count, const std::function<void(size_t)> &work)
+{
+    if (count == 0)
+        return;
+
+    // État partagé avec les threads d'aide, il doit survivre aux aides qui démarrent après la fin
+    struct Parallel_state {
+        std::atomic<size_t> next = 0;
+        std::atomic<size_t> done = 0;
+        size_t count = 0;
+        const std::function<void(size_t)> *work = nullptr;
+        std::mutex mtx;
+        std::condition_variable cond;
+    };
+
+    auto state = std::make_shared<Parallel_state>();
+    state->count = count;
+    state->work = &work;
+
+    // Chacun prend le prochain indice libre, 'work' n'est utilisé que pour un indice réellement obtenu
+    auto run = [](Parallel_state &shared) {
+        size_t finished = 0;
+        for (size_t index = shared.next.fetch_add(1); index < shared.count; index = shared.next.fetch_add(1))
+        {
+            (*shared.work)(index);
+            finished++;
+        }
+
+        if (finished > 0 && shared.done.fetch_add(finished) + finished == shared.count)
+        {
+            std::lock_guard<std::mutex> lock(shared.mtx);
+            shared.cond.notify_all();
+        }
+    };
+
+    size_t helpers = std::min(count - 1, m_threads.size());
+    for (size_t i = 0; i < helpers; i++)
+        submit([state, run]() { run(*state); });
+
+    run(*state);
+
+    // On attend seulement les indices déjà pris par les aides, pas les aides encore en file
+    std::unique_lock<std::mutex> lock(state->mtx);
+    state->cond.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+
+void Thread_pool::worker_loop(unsigned int index)
+{
+    std::function<void()> task;
+
+    while (true)
+    {
+        // On prend d'abord dans sa propre file, sinon on vole dans celle des autres
+        if (pop_task(index, task) || steal_task(index, task))
+        {
+            m_pending_tasks--;
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        // Rien à faire : on dort jusqu'à l'arrivée d'une tâche ou l'arrêt du pool
+        std::unique_lock<std::mutex> lock(m_sleep_mtx);
+        m_sleep_cond.wait(lock, [this]() { return m_stop || m_pending_tasks > 0; });
+        if (m_stop && m_pending_tasks == 0)
+            return;
+    }
+}
+
+
+bool Thread_pool::pop_task(unsigned int index, std::function<void()> &task)
+{
+    // Le propriétaire dépile par l'arrière (la tâche la plus récente, encore chaude en cache)
+    Work_queue &queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mtx);
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+
+bool Thread_pool::steal_task(unsigned int index, std::function<void()> &task)
+{
+    // On parcourt les autres files en partant de la voisine et on vole la tâche la plus ancienne
+    for (unsigned int i = 1; i < m_queues.size(); i++)
+    {
+        Work_queue &queue = *m_queues[(index + i) % m_queues.size()];
+        std::unique_lock<std::mutex> lock(queue.mtx, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty())
+            continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+
+unsigned int Thread_pool::return_threads_count() const
+{
+    return static_cast<unsigned int>(m_threads.size());
+}
+
+unsigned int Thread_pool::return_pending_tasks() const
+{
+    return m_pending_tasks;
+}
+
+
+Thread_pool::~Thread_pool()
+{
+    {
+        // On demande l'arrêt, les threads terminent d'abord les tâches encore en file
+        std::lock_guard<std::mutex> lock(m_sleep_mtx);
+        m_stop = true;
+    }
+    m_sleep_cond.notify_all();
+
+    for (auto &thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
@@ -0,0 +1,63 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_THREAD_POOL_HPP
+#define MEINCANVAS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+
+
+class Thread_pool {
+private:
+    // Chaque thread possède sa propre file : il dépile par l'arrière, les autres volent par l'avant
+    struct Work_queue {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Work_queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_sleep_mtx;
+    std::condition_variable m_sleep_cond;
+
+    std::atomic<unsigned int> m_pending_tasks = 0;
+    std::atomic<unsigned int> m_next_queue = 0;
+    std::atomic<bool> m_stop = false;
+
+private:
+    void worker_loop(unsigned int index);
+    bool pop_task(unsigned int index, std::function<void()> &task);
+    bool steal_task(unsigned int index, std::function<void()> &task);
+
+public:
+    Thread_pool() = delete;
+    explicit Thread_pool(unsigned int threads_count);
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    std::future<void> submit(std::function<void()> work);
+
+    // Exécute work(0) .. work(count - 1) en parallèle et attend la fin, l'appelant participe au travail
+    // L'appelant ne dépend jamais d'un thread occupé ailleurs : il prend lui-même les indices restants
+    void parallel_for(size_t count, const std::function<void(size_t)> &work);
+
+    [[nodiscard]] unsigned int return_threads_count() const;
+    [[nodiscard]] unsigned int return_pending_tasks() const;
+
+    ~Thread_pool();
+};
+
+
+#endif //MEINCANVAS_THREAD_POOL_HPP
@@ -11,104 +11,258 @@ namespace Threads_Mutex
 }
 
 
-void ThreadsWorkers::create_worker_by_id(const std::string &id, std::function<void()> work, bool can_be_run, bool self_destruct)
+ThreadsWorkers::ThreadsWorkers()
 {
-    // On verrouille l'accès à m_workers
-    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
-    // On ajoute un nouveau worker avec son id, son travail, et s'il peut être exécuté
-    m_workers.push_back(std::move(std::make_unique<Workers>(Workers{id, false, can_be_run, self_destruct, std::move(work)})));
+    // Le pool est dimensionné sur le nombre de coeurs, les workers long_running ont leurs propres threads
+    m_pool = std::make_unique<Thread_pool>(std::max(std::thread::hardware_concurrency(), 2u));
+    m_timer_wheel = std::make_unique<Timer_wheel>(m_pool.get());
+    m_task_graph = std::make_unique<Task_graph>(m_pool.get());
+}
+
+
+ThreadsWorkers::~ThreadsWorkers()
+{
+    // Les workers long_running doivent voir la demande d'arrêt, on les attend avant de libérer le reste
+    std::unordered_map<uint64_t, std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_worker_threads_mtx);
+        threads.swap(m_worker_threads);
+    }
+    for (auto &thread : threads)
+        if (thread.second.joinable())
+            thread.second.join();
+}
+
+
+Handle ThreadsWorkers::create_worker_by_id(const std::string &id, std::function<void()> work, bool can_be_run, bool self_destruct, bool long_running)
+{
+    Handle handle;
+    {
+        // On verrouille l'accès à m_workers
+        std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+        // On ajoute un nouveau worker avec son id, son travail, et s'il peut être exécuté
+        handle = m_workers.insert(Workers{id, false, can_be_run, self_destruct, long_running, std::move(work)}, id);
+    }
+
+    // La poignée est invalide si un worker porte déjà cet id
+    if (!handle.is_valid()) {
+        std::cout << "Worker " << id << " already exists" << std::endl;
+        return handle;
+    }
+
+    // Le superviseur doit lancer ce nouveau worker
+    signal_changes();
+    return handle;
 }
 
 
 void ThreadsWorkers::run_workers()
 {
+    // On récupère les workers qui ont signalé leur fin depuis le dernier passage
+    std::vector<Handle> finished_workers;
+    {
+        std::lock_guard<std::mutex> lock(m_changes_mtx);
+        finished_workers.swap(m_finished_workers);
+        m_changes_pending = false;
+    }
+
     // ON update le status de chaque worker (s'il travaille ou non)
-    set_working_status();
-    remove_finished_threads();
+    if (!finished_workers.empty())
+    {
+        join_worker_threads(finished_workers);
+        set_working_status(finished_workers);
+        remove_finished_threads(finished_workers);
+    }
 
     // On lance les threads
-    for (auto &worker: m_workers)
-    {
+    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+    unsigned int running_workers = 0;
+    m_workers.for_each([&running_workers](Handle, Workers &worker) {
+        if (worker.working)
+            running_workers++;
+    });
+    m_workers.for_each([this, &running_workers](Handle handle, Workers &worker) {
         // Si le nombre de threads en cours d'exécution est supérieur ou égal au nombre maximal de threads, on arrête
-        if (numbers_of_running_workers() >= m_max_threads)
-            break;
+        if (running_workers >= m_max_threads)
+            return;
 
         // Si le worker ne peut pas être exécuté ou s'il est déjà en train de travailler, on passe au suivant
-        if (!worker->can_be_run || worker->working)
-            continue;
+        if (!worker.can_be_run || worker.working)
+            return;
 
-        // On lance le thread
-        worker->working = true;
-        m_futures_map[worker->id] = std::async(std::launch::async, worker->work);
-    }
+        // Le worker signale lui-même sa fin
+        worker.working = true;
+        running_workers++;
+        auto task = [this, handle, id = worker.id, work = worker.work]() {
+            try {
+                work();
+            } catch (const std::exception &e) {
+                std::cout << "Worker " << id << " failed : " << e.what() << std::endl;
+            }
+            signal_worker_finished(handle);
+        };
+
+        // Un worker qui se termine passe par le pool, sans création de thread à chaque relance
+        if (!worker.long_running)
+        {
+            m_pool->submit(std::move(task));
+            return;
+        }
+
+        // Une boucle permanente garderait un thread du pool jusqu'à l'arrêt : elle a son propre thread
+        std::lock_guard<std::mutex> threads_lock(m_worker_threads_mtx);
+        m_worker_threads[handle.to_key()] = std::thread(std::move(task));
+    });
 
 }
 
 
-void ThreadsWorkers::quit_all_threads()
+void ThreadsWorkers::join_worker_threads(const std::vector<Handle> &finished_workers)
 {
-    // On empêche les workers de pouvoir redémarrer et on les marque pour destruction
-    // On ne les supprime pas tout de suite pour ne pas interférer avec les threads en cours d'exécution
-    for (auto &worker : m_workers)
+    // Le worker long_running a signalé sa fin : son thread n'a plus qu'à sortir, la jointure est immédiate
+    // Les workers passés par le pool ne sont pas dans m_worker_threads
+    std::vector<std::thread> threads;
     {
-        worker->can_be_run = false;
-        worker->self_destruct = true;
+        std::lock_guard<std::mutex> lock(m_worker_threads_mtx);
+        for (const auto &handle : finished_workers)
+        {
+            auto thread = m_worker_threads.find(handle.to_key());
+            if (thread == m_worker_threads.end())
+                continue;
+
+            threads.push_back(std::move(thread->second));
+            m_worker_threads.erase(thread);
+        }
     }
 
+    for (auto &thread : threads)
+        if (thread.joinable())
+            thread.join();
+}
+
+
+void ThreadsWorkers::submit_task(std::function<void()> work)
+{
+    // Tâche ponctuelle exécutée directement dans le pool, sans worker ni id
+    m_pool->submit(std::move(work));
+}
+
+
+void ThreadsWorkers::parallel_for(size_t count, const std::function<void(size_t)> &work)
+{
+    // Travail découpé en indices indépendants, réparti sur le pool et le thread appelant
+    m_pool->parallel_for(count, work);
+}
+
+
+void ThreadsWorkers::wait_for_changes(const bool &quit)
+{
+    // On attend qu'un worker se termine ou que la liste des workers change
+    // Le délai ne sert qu'à revérifier 'quit', qui n'est pas protégé par m_changes_mtx
+    std::unique_lock<std::mutex> lock(m_changes_mtx);
+    m_changes_cond.wait_for(lock, std::chrono::milliseconds(static_cast<long>(100)), [this, &quit]() {
+        return m_changes_pending || quit;
+    });
+}
+
+
+void ThreadsWorkers::wake_up()
+{
+    // On réveille le superviseur, par exemple pour qu'il voie la demande d'arrêt
+    signal_changes();
 }
 
 
-void ThreadsWorkers::remove_finished_threads() // Cette fonction supprime les threads terminés mais pas les m_workers associés
+void ThreadsWorkers::signal_worker_finished(Handle handle)
 {
-    std::vector<std::string> keys_to_remove;
     {
-        std::lock_guard<std::mutex> lock(Threads_Mutex::mtx); // Verrouiller l'accès à m_futures_map
-        for (auto &thread: m_futures_map)
-        {
-            // Si le thread est terminé, on le marque pour suppression
-            if (thread.second.valid() && thread.second.wait_for(std::chrono::milliseconds(static_cast<long>(0))) == std::future_status::ready)
-            {
-                keys_to_remove.push_back(thread.first);
-            }
-        }
+        std::lock_guard<std::mutex> lock(m_changes_mtx);
+        m_finished_workers.push_back(handle);
+        m_changes_pending = true;
     }
+    m_changes_cond.notify_all();
+}
 
-    // On supprime les threads terminés
-    for (const auto &key : keys_to_remove) {
-        {
-            // On verrouille l'accès à m_futures_map
-            std::lock_guard<std::mutex> lock(Threads_Mutex::mtx); // Verrouiller l'accès à m_futures_map
-            m_futures_map.erase(key);
-        }
 
+void ThreadsWorkers::signal_changes()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_changes_mtx);
+        m_changes_pending = true;
+    }
+    m_changes_cond.notify_all();
+}
+
+
+void ThreadsWorkers::quit_all_threads()
+{
+    // On empêche les workers de pouvoir redémarrer et on les marque pour destruction
+    // On ne les supprime pas tout de suite pour ne pas interférer avec les threads en cours d'exécution
+    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+    m_workers.for_each([](Handle, Workers &worker) {
+        worker.can_be_run = false;
+        worker.self_destruct = true;
+    });
+
+    // Les tâches périodiques ne sont plus relancées
+    m_timer_wheel->delete_all_tasks();
+}
+
+
+bool ThreadsWorkers::create_periodic_task_by_id(const std::string &id, double rate, std::function<void()> work)
+{
+    // La tâche est réveillée 'rate' fois par seconde par la roue temporelle, sans occuper de thread entre deux exécutions
+    bool created = m_timer_wheel->create_task_by_id(id, rate, std::move(work));
+    if (!created)
+        std::cout << "Periodic task " << id << " could not be created" << std::endl;
+
+    return created;
+}
+
+bool ThreadsWorkers::delete_periodic_task_by_id(const std::string &id)
+{
+    return m_timer_wheel->delete_task_by_id(id);
+}
+
+uint64_t ThreadsWorkers::return_periodic_task_overruns(const std::string &id) const
+{
+    // Nombre de ticks sautés car l'exécution précédente n'était pas terminée ou arrivait en retard
+    return m_timer_wheel->return_task_overruns(id);
+}
+
+uint64_t ThreadsWorkers::return_periodic_task_runs(const std::string &id) const
+{
+    return m_timer_wheel->return_task_runs(id);
+}
+
+
+void ThreadsWorkers::remove_finished_threads(const std::vector<Handle> &finished_workers) // Cette fonction supprime les workers terminés qui peuvent être détruits
+{
+    for (const auto &handle : finished_workers) {
         // Si le worker peut être détruit, on le supprime
-        if (can_worker_be_self_destruct(key)) {
-            delete_worker_by_id(key);
+        if (can_worker_be_self_destruct(handle)) {
+            delete_worker(handle);
         }
     }
 }
 
 
-void ThreadsWorkers::set_working_status()
+void ThreadsWorkers::set_working_status(const std::vector<Handle> &finished_workers)
 {
-    // On vérifie si les threads sont terminés
-    for (auto &worker : m_workers)
+    // On ne regarde que les workers qui ont signalé leur fin, accès direct par poignée
+    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+    for (const auto &handle : finished_workers)
     {
-        // Si le worker n'est pas dans m_futures_map, on passe au suivant
-        if (m_futures_map.find(worker->id) == m_futures_map.end())
+        Workers *worker = m_workers.get(handle);
+        if (!worker)
             continue;
 
-        // Si le worker est en train de travailler et que le thread est terminé, on le marque comme non travaillant
-        auto &future = m_futures_map.find(worker->id)->second;
-        if (future.valid() && future.wait_for(std::chrono::milliseconds(static_cast<long>(0))) == std::future_status::ready)
-        {
-            //std::cout << m_futures_map.size() << " and Thread " << worker->id << " finished" << std::endl;
-            worker->working = false;
+        // Le worker a terminé, on le marque comme non travaillant
+        worker->working = false;
 
-            // Si le worker peut être détruit, on empêche son redémarrage
-            if(worker->self_destruct)
-                worker->can_be_run = false;
-        }
+        // Si le worker peut être détruit, on empêche son redémarrage
+        if(worker->self_destruct)
+            worker->can_be_run = false;
     }
 }
 
@@ -116,7 +270,13 @@ void ThreadsWorkers::delete_worker_by_id(const std::string &id)
 {
     // On verrouille l'accès à m_workers et on supprime le worker avec l'id correspondant
     std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
-    m_workers.erase(std::remove_if(m_workers.begin(), m_workers.end(), [id](const std::unique_ptr<Workers>& worker){return worker->id == id;}), m_workers.end());
+    m_workers.erase(id);
+}
+
+void ThreadsWorkers::delete_worker(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+    m_workers.erase(handle);
 }
 
 unsigned int ThreadsWorkers::return_workers_size() const
@@ -126,32 +286,86 @@ unsigned int ThreadsWorkers::return_workers_size() const
     return m_workers.size();
 }
 
+bool ThreadsWorkers::create_job_by_id(const std::string &id, std::function<void()> work, const std::vector<std::string> &dependencies)
+{
+    // Le job sera exécuté à chaque frame, après tous les jobs dont il dépend
+    return m_task_graph->create_job_by_id(id, std::move(work), dependencies);
+}
+
+bool ThreadsWorkers::delete_job_by_id(const std::string &id)
+{
+    return m_task_graph->delete_job_by_id(id);
+}
+
+bool ThreadsWorkers::launch_frame_jobs()
+{
+    // On lance les jobs prêts, les suivants partent d'eux-mêmes quand leurs dépendances se terminent
+    return m_task_graph->launch_frame();
+}
+
+void ThreadsWorkers::wait_frame_jobs()
+{
+    // Barrière : on attend que tous les jobs de la frame soient terminés
+    m_task_graph->wait_frame();
+}
+
+unsigned int ThreadsWorkers::return_pool_size() const
+{
+    return m_pool->return_threads_count();
+}
+
 unsigned int ThreadsWorkers::numbers_of_running_workers() const
 {
     // On verrouille l'accès à m_workers et on retourne le nombre de workers en train de travailler
     std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
-    return std::count_if(m_workers.begin(), m_workers.end(), [](const std::unique_ptr<Workers>& worker){return worker->working;});
+    unsigned int running_workers = 0;
+    m_workers.for_each([&running_workers](Handle, const Workers &worker) {
+        if (worker.working)
+            running_workers++;
+    });
+    return running_workers;
 }
 
-bool ThreadsWorkers::can_worker_be_self_destruct(const std::string& id) const
+bool ThreadsWorkers::can_worker_be_self_destruct(Handle handle) const
 {
-    // On verrouille l'accès à m_workers et on retourne si le worker avec l'id correspondant peut être détruita
+    // On verrouille l'accès à m_workers et on retourne si le worker avec cette poignée peut être détruit
     std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
-    auto it = std::find_if(m_workers.begin(), m_workers.end(), [&id](const std::unique_ptr<Workers>& worker){return worker->id == id;});
-    return it != m_workers.end() && (*it)->self_destruct;
+    const Workers *worker = m_workers.get(handle);
+    return worker && worker->self_destruct;
 }
 
 void ThreadsWorkers::edit_worker_by_id(const std::string &id, bool can_be_run, bool self_destruct)
 {
-    // On verrouille l'accès à m_workers et on modifie les paramètres du worker avec l'id correspondant
-    std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
-    auto it = std::find_if(m_workers.begin(), m_workers.end(), [&id](const std::unique_ptr<Workers>& worker){return worker->id == id;});
-    if (it != m_workers.end()) {
-        (*it)->can_be_run = can_be_run;
-        (*it)->self_destruct = self_destruct;
-    } else {
+    Handle handle;
+    {
+        // On verrouille l'accès à m_workers et on cherche la poignée du worker avec l'id correspondant
+        std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+        handle = m_workers.find(id);
+    }
+
+    if (!handle.is_valid()) {
         std::cout << "Worker " << id << " not found" << std::endl;
+        return;
     }
+
+    edit_worker(handle, can_be_run, self_destruct);
+}
+
+void ThreadsWorkers::edit_worker(Handle handle, bool can_be_run, bool self_destruct)
+{
+    {
+        // On verrouille l'accès à m_workers et on modifie les paramètres du worker
+        std::lock_guard<std::mutex> lock(Threads_Mutex::mtx);
+        Workers *worker = m_workers.get(handle);
+        if (!worker)
+            return;
+
+        worker->can_be_run = can_be_run;
+        worker->self_destruct = self_destruct;
+    }
+
+    // Le superviseur doit prendre en compte le nouvel état du worker
+    signal_changes();
 }
 
 
@@ -16,11 +16,16 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <utility>
 #include <pthread.h>
 
 #include "../main_prog/data.hpp"
+#include "thread_pool.hpp"
+#include "timer_wheel.hpp"
+#include "task_graph.hpp"
+#include "../registry/registry.hpp"
 
 class ThreadsWorkers {
 private:
@@ -29,34 +34,75 @@ private:
         bool working;
         bool can_be_run;
         bool self_destruct;
+        // Worker qui boucle jusqu'à l'arrêt du programme : il a son propre thread au lieu d'un thread du pool
+        bool long_running;
         std::function<void()> work;
     };
 
     unsigned int m_max_threads = (std::thread::hardware_concurrency() - 2) * 10; // -2 to keep some threads for the main program
 
-    std::vector<std::unique_ptr<Workers>> m_workers;
-    std::map<std::string, std::future<void>> m_futures_map;
+    // Les workers sont rangés par poignée, l'id texte n'est plus qu'un nom pour les retrouver
+    Registry<Workers> m_workers;
+    // File des workers terminés, remplie par les workers eux-mêmes à la fin de leur travail
+    std::vector<Handle> m_finished_workers;
+    bool m_changes_pending = false;
+    std::mutex m_changes_mtx;
+    std::condition_variable m_changes_cond;
+
+    // Threads des workers long_running : une boucle permanente ne doit jamais prendre un thread du pool
+    // aux jobs de frame, aux tâches périodiques ou à parallel_for
+    // Rangés par clé de poignée, un thread est joint quand son worker a signalé sa fin
+    std::unordered_map<uint64_t, std::thread> m_worker_threads;
+    std::mutex m_worker_threads_mtx;
+
+    // Pool de threads persistant : workers qui se terminent, tâches ponctuelles et périodiques, jobs de frame
+    std::unique_ptr<Thread_pool> m_pool;
+    // Roue temporelle des tâches périodiques, elles s'exécutent dans le pool
+    std::unique_ptr<Timer_wheel> m_timer_wheel;
+    // Graphe des jobs exécutés à chaque frame, dans l'ordre de leurs dépendances
+    std::unique_ptr<Task_graph> m_task_graph;
 
 
 private:
-    void set_working_status();
-    void remove_finished_threads();
-    [[nodiscard]] bool can_worker_be_self_destruct(const std::string& id) const;
+    void set_working_status(const std::vector<Handle> &finished_workers);
+    void remove_finished_threads(const std::vector<Handle> &finished_workers);
+    void signal_worker_finished(Handle handle);
+    void signal_changes();
+    void join_worker_threads(const std::vector<Handle> &finished_workers);
+    [[nodiscard]] bool can_worker_be_self_destruct(Handle handle) const;
 
 
 public:
-    ThreadsWorkers() = default;
+    ThreadsWorkers();
 
-    void create_worker_by_id(const std::string& id, std::function<void()> work, bool can_be_run = true, bool self_destruct = true);
+    Handle create_worker_by_id(const std::string& id, std::function<void()> work, bool can_be_run = true, bool self_destruct = true, bool long_running = false);
     void delete_worker_by_id(const std::string& id);
+    void delete_worker(Handle handle);
     void edit_worker_by_id(const std::string& id, bool can_be_run = true, bool self_destruct = true);
+    void edit_worker(Handle handle, bool can_be_run = true, bool self_destruct = true);
     void quit_all_threads();
+
+    bool create_periodic_task_by_id(const std::string& id, double rate, std::function<void()> work);
+    bool delete_periodic_task_by_id(const std::string& id);
+    [[nodiscard]] uint64_t return_periodic_task_overruns(const std::string& id) const;
+    [[nodiscard]] uint64_t return_periodic_task_runs(const std::string& id) const;
+
+    bool create_job_by_id(const std::string& id, std::function<void()> work, const std::vector<std::string>& dependencies = {});
+    bool delete_job_by_id(const std::string& id);
+    bool launch_frame_jobs();
+    void wait_frame_jobs();
+
     [[nodiscard]] unsigned int return_workers_size() const;
     [[nodiscard]] unsigned int numbers_of_running_workers() const;
+    [[nodiscard]] unsigned int return_pool_size() const;
 
     void run_workers();
+    void submit_task(std::function<void()> work);
+    void parallel_for(size_t count, const std::function<void(size_t)> &work);
+    void wait_for_changes(const bool &quit);
+    void wake_up();
 
-    ~ThreadsWorkers() = default;
+    ~ThreadsWorkers();
 };
 
 
@@ -0,0 +1,254 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#include "timer_wheel.hpp"
+
+#include <iostream>
+
+
+Timer_wheel::Timer_wheel(Thread_pool *pool) : m_start(Clock::now()), m_pool(pool)
+{
+    m_thread = std::thread([this]() {
+        pthread_setname_np(pthread_self(), "prog-timer");
+        timer_loop();
+    });
+}
+
+
+bool Timer_wheel::create_task_by_id(const std::string &id, double rate, std::function<void()> work)
+{
+    // Une fréquence nulle ou négative n'a pas de sens pour une tâche périodique
+    if (rate <= 0.0)
+        return false;
+
+    auto task = std::make_shared<Periodic_task>();
+    task->id = id;
+    task->period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    task->work = std::move(work);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        if (m_tasks.find(id) != m_tasks.end())
+            return false;
+
+        // Si la roue était vide, son thread dormait : on la recale sur l'heure actuelle
+        Clock::time_point now = Clock::now();
+        if (m_tasks.empty())
+            m_current_tick = static_cast<uint64_t>((now - m_start) / m_tick);
+
+        // Première exécution au prochain tick
+        task->deadline = now;
+        m_tasks[id] = task;
+        insert_task(task);
+        m_schedule_changed = true;
+    }
+    m_cond.notify_all();
+
+    return true;
+}
+
+
+bool Timer_wheel::delete_task_by_id(const std::string &id)
+{
+    // La tâche est seulement marquée, elle sera retirée de sa case quand la roue y passera
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto it = m_tasks.find(id);
+    if (it == m_tasks.end())
+        return false;
+
+    it->second->cancelled = true;
+    m_tasks.erase(it);
+    return true;
+}
+
+
+void Timer_wheel::delete_all_tasks()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    for (auto &task : m_tasks)
+        task.second->cancelled = true;
+    m_tasks.clear();
+}
+
+
+uint64_t Timer_wheel::return_task_runs(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto it = m_tasks.find(id);
+    return it != m_tasks.end() ? it->second->runs.load() : 0;
+}
+
+
+uint64_t Timer_wheel::return_task_overruns(const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    auto it = m_tasks.find(id);
+    return it != m_tasks.end() ? it->second->overruns.load() : 0;
+}
+
+
+unsigned int Timer_wheel::return_tasks_size()
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return static_cast<unsigned int>(m_tasks.size());
+}
+
+
+Timer_wheel::Clock::time_point Timer_wheel::tick_time(uint64_t tick) const
+{
+    return m_start + m_tick * static_cast<Clock::rep>(tick);
+}
+
+
+void Timer_wheel::timer_loop()
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    while (!m_stop)
+    {
+        // Aucune tâche : on dort jusqu'à ce qu'on en ajoute une
+        if (m_tasks.empty())
+        {
+            m_cond.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            continue;
+        }
+
+        // On dort jusqu'à la prochaine case occupée (ou la prochaine redescente du niveau supérieur), pas à chaque tick
+        // Une tâche ajoutée entre temps peut tomber plus tôt : elle nous réveille pour recalculer l'échéance
+        m_schedule_changed = false;
+        m_cond.wait_until(lock, tick_time(next_wake_tick()), [this]() { return m_stop || m_schedule_changed; });
+
+        // On rattrape tous les ticks écoulés (le thread a pu être retardé)
+        Clock::time_point now = Clock::now();
+        while (!m_stop && tick_time(m_current_tick + 1) <= now)
+            advance_one_tick();
+    }
+}
+
+
+uint64_t Timer_wheel::next_wake_tick() const
+{
+    // Prochain début de tour du niveau 0, où les tâches des niveaux supérieurs redescendent
+    uint64_t cascade_tick = (m_current_tick / m_level0_size + 1) * m_level0_size;
+
+    // Les tâches du niveau 0 sont à moins d'un tour : on cherche la première case occupée
+    for (uint64_t tick = m_current_tick + 1; tick < cascade_tick; tick++)
+    {
+        if (!m_level0[tick % m_level0_size].empty())
+            return tick;
+    }
+
+    return cascade_tick;
+}
+
+
+void Timer_wheel::advance_one_tick()
+{
+    m_current_tick++;
+
+    // En début de tour du niveau inférieur, on redescend les tâches du niveau supérieur
+    if (m_current_tick % m_level0_size == 0)
+    {
+        if ((m_current_tick >> m_level0_bits) % m_level_size == 0)
+        {
+            Slot slot2;
+            slot2.swap(m_level2[(m_current_tick >> (m_level0_bits + m_level_bits)) % m_level_size]);
+            for (auto &task : slot2)
+                insert_task(task);
+        }
+
+        Slot slot1;
+        slot1.swap(m_level1[(m_current_tick >> m_level0_bits) % m_level_size]);
+        for (auto &task : slot1)
+            insert_task(task);
+    }
+
+    // On traite les tâches arrivées à échéance dans cette case
+    Slot expired;
+    expired.swap(m_level0[m_current_tick % m_level0_size]);
+    for (auto &task : expired)
+    {
+        if (task->cancelled)
+            continue;
+
+        // Une tâche trop loin pour le dernier niveau a été posée au bout de la roue, on la replace
+        if (task->deadline > tick_time(m_current_tick))
+        {
+            insert_task(task);
+            continue;
+        }
+
+        fire_task(task);
+
+        // Échéance suivante calculée sur la ligne de temps absolue pour ne pas dériver
+        // Si on a raté des périodes entières, on les compte comme dépassements et on les saute
+        task->deadline += task->period;
+        Clock::time_point now = tick_time(m_current_tick);
+        if (task->deadline < now)
+        {
+            auto missed = static_cast<uint64_t>((now - task->deadline) / task->period) + 1;
+            task->overruns += missed;
+            task->deadline += task->period * static_cast<Clock::rep>(missed);
+        }
+
+        insert_task(task);
+    }
+}
+
+
+void Timer_wheel::insert_task(const std::shared_ptr<Periodic_task> &task)
+{
+    // Nombre de ticks jusqu'à l'échéance, arrondi au tick supérieur, au moins le prochain tick
+    Clock::duration delay = task->deadline - tick_time(m_current_tick);
+    uint64_t delta = delay <= Clock::duration::zero() ? 1 : static_cast<uint64_t>((delay + m_tick - Clock::duration(1)) / m_tick);
+    if (delta == 0)
+        delta = 1;
+
+    uint64_t target = m_current_tick + delta;
+
+    if (delta < m_level0_size)
+        m_level0[target % m_level0_size].push_back(task);
+    else if (delta < m_level0_size * m_level_size)
+        m_level1[(target >> m_level0_bits) % m_level_size].push_back(task);
+    else if (delta < m_level0_size * m_level_size * m_level_size)
+        m_level2[(target >> (m_level0_bits + m_level_bits)) % m_level_size].push_back(task);
+    else
+        // Au-delà de la roue, on la pose au bout du dernier niveau, elle sera replacée plus tard
+        m_level2[((m_current_tick >> (m_level0_bits + m_level_bits)) + m_level_size - 1) % m_level_size].push_back(task);
+}
+
+
+void Timer_wheel::fire_task(const std::shared_ptr<Periodic_task> &task)
+{
+    // Si l'exécution précédente n'est pas terminée, c'est un dépassement : on saute ce tick
+    if (task->running.exchange(true))
+    {
+        task->overruns++;
+        return;
+    }
+
+    m_pool->submit([task]() {
+        try {
+            task->work();
+        } catch (const std::exception &e) {
+            std::cout << "Periodic task " << task->id << " failed : " << e.what() << std::endl;
+        }
+        task->runs++;
+        task->running = false;
+    });
+}
+
+
+Timer_wheel::~Timer_wheel()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_stop = true;
+        for (auto &task : m_tasks)
+            task.second->cancelled = true;
+    }
+    m_cond.notify_all();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
@@ -0,0 +1,96 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+#ifndef MEINCANVAS_TIMER_WHEEL_HPP
+#define MEINCANVAS_TIMER_WHEEL_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+
+#include "thread_pool.hpp"
+
+
+// Roue temporelle hiérarchique : un seul thread réveille toutes les tâches périodiques
+// et les fait exécuter par le pool de threads
+class Timer_wheel {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Periodic_task {
+        std::string id;
+        Clock::duration period;
+        Clock::time_point deadline;
+        std::function<void()> work;
+
+        std::atomic<bool> running = false;
+        std::atomic<bool> cancelled = false;
+        std::atomic<uint64_t> runs = 0;
+        std::atomic<uint64_t> overruns = 0;
+    };
+
+    // Niveau 0 : 256 cases de 1 ms, niveau 1 : 64 cases de 256 ms, niveau 2 : 64 cases de ~16 s
+    static constexpr Clock::duration m_tick = std::chrono::milliseconds(1);
+    static constexpr uint64_t m_level0_bits = 8;
+    static constexpr uint64_t m_level_bits = 6;
+    static constexpr uint64_t m_level0_size = 1 << m_level0_bits;
+    static constexpr uint64_t m_level_size = 1 << m_level_bits;
+
+    using Slot = std::vector<std::shared_ptr<Periodic_task>>;
+
+    std::array<Slot, m_level0_size> m_level0;
+    std::array<Slot, m_level_size> m_level1;
+    std::array<Slot, m_level_size> m_level2;
+
+    std::map<std::string, std::shared_ptr<Periodic_task>> m_tasks;
+
+    Clock::time_point m_start;
+    uint64_t m_current_tick = 0;
+
+    Thread_pool *m_pool;
+
+    std::mutex m_mtx;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+    // Une tâche a été ajoutée pendant que le thread dormait
+    bool m_schedule_changed = false;
+    std::thread m_thread;
+
+private:
+    void timer_loop();
+    void advance_one_tick();
+    [[nodiscard]] uint64_t next_wake_tick() const;
+    void insert_task(const std::shared_ptr<Periodic_task> &task);
+    void fire_task(const std::shared_ptr<Periodic_task> &task);
+    [[nodiscard]] Clock::time_point tick_time(uint64_t tick) const;
+
+public:
+    Timer_wheel() = delete;
+    explicit Timer_wheel(Thread_pool *pool);
+    Timer_wheel(const Timer_wheel&) = delete;
+    Timer_wheel& operator=(const Timer_wheel&) = delete;
+
+    bool create_task_by_id(const std::string &id, double rate, std::function<void()> work);
+    bool delete_task_by_id(const std::string &id);
+    void delete_all_tasks();
+
+    [[nodiscard]] uint64_t return_task_runs(const std::string &id);
+    [[nodiscard]] uint64_t return_task_overruns(const std::string &id);
+    [[nodiscard]] unsigned int return_tasks_size();
+
+    ~Timer_wheel();
+};
+
+
+#endif //MEINCANVAS_TIMER_WHEEL_HPP
@@ -0,0 +1,99 @@
+//
+// Created by dell_nicolas on 14/06/24.
+//
+
+#ifndef CANVAS_FRAME_EXCHANGE_HPP
+#define CANVAS_FRAME_EXCHANGE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Triple tampon sans verrou entre un producteur (le décodeur de VLC) et un consommateur (le thread de rendu)
+// Un tampon est écrit par le producteur, un est lu par le consommateur, le troisième garde la dernière image prête
+// Publier échange le tampon écrit avec celui du milieu, prendre échange le tampon lu avec celui du milieu :
+// aucun des deux côtés n'attend l'autre, et une image non prise est remplacée par la suivante (la plus récente gagne)
+class Frame_exchange {
+private:
+    // Index du tampon du milieu, avec ce bit si son image n'a pas encore été prise
+    static constexpr uint8_t m_fresh_bit = 0x4;
+    static constexpr uint8_t m_index_mask = 0x3;
+
+    std::vector<uint8_t> m_buffers[3];
+    size_t m_frame_bytes = 0;
+
+    // Chaque côté sur sa propre ligne de cache
+    alignas(64) uint8_t m_write_index = 0;
+    alignas(64) std::atomic<uint8_t> m_middle = 1;
+    alignas(64) uint8_t m_read_index = 2;
+
+    std::atomic<uint64_t> m_published_count = 0;
+    std::atomic<uint64_t> m_dropped_count = 0;
+    std::atomic<uint64_t> m_repeated_count = 0;
+
+public:
+    Frame_exchange() = default;
+    Frame_exchange(const Frame_exchange&) = delete;
+    Frame_exchange& operator=(const Frame_exchange&) = delete;
+    ~Frame_exchange() = default;
+
+    // À appeler avant que le producteur ne démarre
+    void resize(size_t frame_bytes)
+    {
+        m_frame_bytes = frame_bytes;
+        for (auto &buffer : m_buffers)
+            buffer.assign(frame_bytes, 0);
+        m_write_index = 0;
+        m_middle.store(1, std::memory_order_relaxed);
+        m_read_index = 2;
+    }
+
+    // Producteur : tampon où écrire la prochaine image
+    [[nodiscard]] uint8_t *return_write_buffer()
+    {
+        return m_buffers[m_write_index].data();
+    }
+
+    // Producteur : l'image écrite devient la dernière image prête
+    void publish()
+    {
+        uint8_t previous = m_middle.exchange(m_write_index | m_fresh_bit, std::memory_order_acq_rel);
+        // L'image précédente n'a jamais été prise par le consommateur : elle est perdue
+        if (previous & m_fresh_bit)
+            m_dropped_count.fetch_add(1, std::memory_order_relaxed);
+        m_write_index = previous & m_index_mask;
+        m_published_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consommateur : prend la dernière image prête, renvoie false si rien n'a été publié depuis
+    // Chaque échec compte dans m_repeated_count : c'est un nombre d'appels (de ticks de rendu), pas d'images présentées deux fois
+    bool take()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & m_fresh_bit))
+        {
+            m_repeated_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint8_t previous = m_middle.exchange(m_read_index, std::memory_order_acq_rel);
+        m_read_index = previous & m_index_mask;
+        return true;
+    }
+
+    // Consommateur : image prise par le dernier take() réussi
+    [[nodiscard]] const uint8_t *return_read_buffer() const
+    {
+        return m_buffers[m_read_index].data();
+    }
+
+    [[nodiscard]] size_t return_frame_bytes() const { return m_frame_bytes; }
+    // Numéro de séquence de la dernière image publiée (0 si aucune), lisible depuis n'importe quel thread
+    [[nodiscard]] uint64_t return_published_count() const { return m_published_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t return_dropped_count() const { return m_dropped_count.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t return_repeated_count() const { return m_repeated_count.load(std::memory_order_relaxed); }
+};
+
+
+#endif //CANVAS_FRAME_EXCHANGE_HPP
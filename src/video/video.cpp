@@ -3,9 +3,16 @@
 //
 
 #include "video.hpp"
+#include "../threads_workers/threads_workers.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
 #include <utility>
 
+#include <unistd.h>
+
 
 namespace Video_Mutex
 {
@@ -13,45 +20,34 @@ namespace Video_Mutex
 }
 
 
-Video::Video(SDL_Renderer *renderer) : m_renderer(renderer) {}
+Video::Video(SDL_Renderer *renderer) : m_renderer(renderer), m_render_thread(std::this_thread::get_id()) {}
 
+Video::~Video()
+{
+    // Une renégociation lancée dans le pool utilise encore la vidéo : on attend qu'elle se termine avant de tout libérer
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    m_loaded_videos.for_each([](Handle, std::unique_ptr<loaded_video> &video) {
+        std::unique_lock<std::mutex> player_lock = lock_player(*video);
+    });
+}
 
-bool Video::load_video_with_id(const std::string &id, const std::string &path, SDL_Rect rect, std::vector<std::string> vec)
+
+std::unique_ptr<Video::loaded_video> Video::create_video(const std::string &id, const std::string &path, SDL_Rect rect, const std::vector<std::string> &vec)
 {
     // On crée un contexte pour la vidéo
-    libvlc_instance_t *vlc_player;
-    libvlc_media_t *m;
-
-    // Créez un tableau de pointeurs const char* pour les arguments de VLC
-    const char** vlc_argv;
-    int vlc_argc;
+    std::unique_ptr<loaded_video> context = std::make_unique<loaded_video>();
 
-    // Si le vecteur est vide, on crée un tableau avec les arguments par défaut
-    if (vec.empty())
-    {
-        vlc_argv = new char const *[]{
-            //"--no-audio", // Don't play audio.
-            "--no-xlib", // Don't use Xlib.
-        };
-        vlc_argc = 1;
-    // Si le vecteur n'est pas vide, on crée un tableau avec les arguments du vecteur
-    } else {
-        // Créez un nouveau tableau de pointeurs const char* de la taille du vecteur
-        vlc_argv = new const char*[vec.size() + 1]; // +1 pour le nullptr à la fin
-
-        // Remplissez le tableau avec les pointeurs vers les chaînes de caractères dans le vecteur
-        for (std::size_t i = 0; i < vec.size(); ++i) {
-            vlc_argv[i] = vec[i].c_str();
-        }
+    // Mesure du chargement : durée et mémoire résidente prise par la vidéo
+    context->load_start = std::chrono::steady_clock::now();
+    context->load_resident_memory = return_resident_memory();
 
-        // Ajoutez un nullptr à la fin du tableau
-        vlc_argv[vec.size()] = nullptr;
-        vlc_argc = static_cast<int>(vec.size());
+    // Instance du pool pour ce jeu d'arguments, créée au premier chargement seulement
+    context->instance = acquire_instance(vec);
+    if (!context->instance) {
+        printf("LibVLC initialization failure.\n");
+        return nullptr;
     }
 
-    // On crée un contexte pour la vidéo
-    std::unique_ptr<loaded_video> context = std::make_unique<loaded_video>();
-
     // On initialise le contexte avec les valeurs passées en paramètres
     // id pour l'identifiant de la vidéo
     context->id = std::make_unique<std::string>(id);
@@ -59,32 +55,55 @@ bool Video::load_video_with_id(const std::string &id, const std::string &path, S
     context->path = std::make_unique<std::string>(path);
     // mutex pour protéger les données de la vidéo
     context->mutex = std::unique_ptr<SDL_mutex, std::function<void(SDL_mutex *)>>(SDL_CreateMutex(), SDL_DestroyMutex);
+    // frame_invalidation pour réveiller la boucle de rendu à chaque nouvelle image
+    context->frame_invalidation = m_frame_invalidation;
+    // damage_tracker pour ne recomposer que la zone de la vidéo à chaque nouvelle image
+    context->damage_tracker = m_damage_tracker;
+    // src_rect est connu à la fin de l'analyse, dst_rect garde la zone demandée (taille de la vidéo si elle est vide)
+    context->src_rect = std::make_unique<SDL_Rect>(SDL_Rect{0, 0, 0, 0});
+    context->dst_rect = std::make_unique<SDL_Rect>(rect);
 
-    // Initialise libVLC.
-    vlc_player = libvlc_new(vlc_argc, vlc_argv);
-    if(nullptr == vlc_player) {
-        printf("LibVLC initialization failure.\n");
+    // Créez un nouveau objet média
+    libvlc_media_t *m = libvlc_media_new_path(context->instance.get(), path.c_str());
+    if (!m) {
+        std::cout << "Video " << path << " could not be opened" << std::endl;
+        return nullptr;
     }
 
-    // Créez un nouveau objet média
-    m = libvlc_media_new_path(vlc_player, path.c_str());
+    // Le média est détaché de notre événement avant d'être libéré, le contexte peut alors disparaître sans risque
+    loaded_video *raw_context = context.get();
+    context->media = std::unique_ptr<libvlc_media_t, std::function<void(libvlc_media_t *)>>(m, [raw_context](libvlc_media_t *media) {
+        libvlc_media_parse_stop(media);
+        libvlc_event_detach(libvlc_media_event_manager(media), libvlc_MediaParsedChanged, media_parsed_changed, raw_context);
+        libvlc_media_release(media);
+    });
 
     // On attache un événement à la vidéo pour savoir quand elle est prête
     libvlc_event_manager_t* em = libvlc_media_event_manager(m);
-    libvlc_event_attach(em, libvlc_MediaParsedChanged, media_parsed_changed, nullptr);
+    libvlc_event_attach(em, libvlc_MediaParsedChanged, media_parsed_changed, raw_context);
+
+    // On lance l'analyse, elle se fait dans un thread de VLC et se termine par l'événement
+    if (libvlc_media_parse_with_options(m, libvlc_media_parse_local, -1) != 0) {
+        std::cout << "Video " << path << " could not be parsed" << std::endl;
+        return nullptr;
+    }
+
+    return context;
+}
 
-    // On parse la vidéo
-    libvlc_media_parse_with_options(m, libvlc_media_parse_local, -1);
 
-    // On attend que la vidéo soit prête
-    while(libvlc_media_get_parsed_status(m) != libvlc_media_parsed_status_done) {
-        // Sleeping time
-        std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<long>(5)));
+bool Video::start_player(loaded_video &video)
+{
+    // Appelée une fois l'analyse terminée, sur le thread qui possède le renderer
+    video.player_started = true;
+    if (video.parsed_status != libvlc_media_parsed_status_done) {
+        set_state(video, Video_state::FAILED);
+        return false;
     }
 
     // On récupère les informations de la vidéo
     libvlc_media_track_t** tracks = nullptr;
-    unsigned int num_tracks = libvlc_media_tracks_get(m, &tracks);
+    unsigned int num_tracks = libvlc_media_tracks_get(video.media.get(), &tracks);
 
     // On récupère la largeur et la hauteur de la vidéo
     unsigned int w = 0, h = 0;
@@ -96,56 +115,262 @@ bool Video::load_video_with_id(const std::string &id, const std::string &path, S
             break;
         }
     }
+    libvlc_media_tracks_release(tracks, num_tracks);
 
-    // On crée un lecteur pour la vidéo
-    context->mp = std::unique_ptr<libvlc_media_player_t, std::function<void(libvlc_media_player_t *)>>(
-            libvlc_media_player_new_from_media(m), libvlc_media_player_release
-    );
+    if (w == 0 || h == 0) {
+        std::cout << "Video " << *video.path << " has no video track" << std::endl;
+        set_state(video, Video_state::FAILED);
+        return false;
+    }
 
-    libvlc_media_tracks_release(tracks, num_tracks);
-    libvlc_media_release(m);
+    video.native_width = static_cast<int>(w);
+    video.native_height = static_cast<int>(h);
 
-    // src_rect pour la taille de la vidéo
-    context->src_rect = std::make_unique<SDL_Rect>(SDL_Rect{0, 0, static_cast<int>(w), static_cast<int>(h)});
+    SDL_LockMutex(video.mutex.get());
     // dst_rect pour la position et la taille de la vidéo
-    context->dst_rect = std::make_unique<SDL_Rect>((rect.w == 0 || rect.h == 0) ? SDL_Rect{0, 0, static_cast<int>(w), static_cast<int>(h)} : rect);
-    // On crée une texture pour la vidéo
-    context->texture = std::unique_ptr<SDL_Texture, std::function<void(SDL_Texture *)>>(
+    if (video.dst_rect->w == 0 || video.dst_rect->h == 0)
+        *video.dst_rect = SDL_Rect{0, 0, static_cast<int>(w), static_cast<int>(h)};
+    SDL_UnlockMutex(video.mutex.get());
+
+    // Taille de décodage choisie d'après dst_rect : une vidéo 4K dans une petite tuile est décodée à la taille de la tuile
+    configure_output(video);
+
+    // On crée une texture pour la vidéo, à la taille de décodage
+    if (!recreate_texture(video)) {
+        set_state(video, Video_state::FAILED);
+        return false;
+    }
+
+    // On crée un lecteur pour la vidéo, détaché de nos événements avant d'être libéré
+    loaded_video *raw_video = &video;
+    libvlc_media_player_t *player = libvlc_media_player_new_from_media(video.media.get());
+    if (!player) {
+        set_state(video, Video_state::FAILED);
+        return false;
+    }
+    video.mp = std::unique_ptr<libvlc_media_player_t, std::function<void(libvlc_media_player_t *)>>(player, [raw_video](libvlc_media_player_t *mp) {
+        libvlc_event_manager_t *em = libvlc_media_player_event_manager(mp);
+        libvlc_event_detach(em, libvlc_MediaPlayerEncounteredError, player_event, raw_video);
+        libvlc_event_detach(em, libvlc_MediaPlayerEndReached, player_event, raw_video);
+        libvlc_media_player_release(mp);
+    });
+
+    // Un fichier analysé peut encore échouer au décodage : l'erreur ou la fin sans image le fera passer à FAILED
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager(player);
+    libvlc_event_attach(em, libvlc_MediaPlayerEncounteredError, player_event, raw_video);
+    libvlc_event_attach(em, libvlc_MediaPlayerEndReached, player_event, raw_video);
+
+    // On attache la vidéo au triple tampon, elle ne sera affichée qu'à sa première image
+    // Le format est donné par callback pour pouvoir être renégocié quand la vidéo change de taille
+    libvlc_video_set_callbacks(video.mp.get(), lock, unlock, display, &video);
+    libvlc_video_set_format_callbacks(video.mp.get(), format_setup, format_cleanup);
+    libvlc_media_player_play(video.mp.get());
+
+    // Changer le niveau du son à 100%
+    libvlc_audio_set_volume(video.mp.get(), 100);
+
+    record_load(video);
+    return true;
+}
+
+
+void Video::record_load(const loaded_video &video)
+{
+    std::lock_guard<std::mutex> lock(m_instances_mtx);
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - video.load_start).count();
+    int64_t load_rss = return_resident_memory() - video.load_resident_memory;
+
+    m_load_statistics.loads++;
+    m_load_statistics.last_load_ms = load_ms;
+    m_load_statistics.last_load_rss_bytes = load_rss;
+    m_load_statistics.mean_load_ms += (load_ms - m_load_statistics.mean_load_ms) / double(m_load_statistics.loads);
+    m_load_statistics.mean_load_rss_bytes += (double(load_rss) - m_load_statistics.mean_load_rss_bytes) / double(m_load_statistics.loads);
+}
+
+
+void Video::set_state(loaded_video &video, Video_state state)
+{
+    // Un seul passage par état final, appelée sous Video_Mutex : le callback est gardé pour notify_state_changes
+    Video_state expected = Video_state::LOADING;
+    if (!video.state.compare_exchange_strong(expected, state))
+        return;
+
+    m_state_changes.push_back(State_change{video.on_state, video.handle, state});
+}
+
+
+void Video::notify_state_changes()
+{
+    // Hors de Video_Mutex : un callback peut supprimer la vidéo ou demander son état sans bloquer
+    std::vector<State_change> changes;
+    {
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        changes.swap(m_state_changes);
+    }
+    if (changes.empty())
+        return;
+
+    for (const auto &change : changes)
+        if (change.callback)
+            change.callback(change.handle, change.state);
+
+    {
+        std::lock_guard<std::mutex> lock(m_state_mtx);
+    }
+    m_state_cond.notify_all();
+}
+
+
+void Video::choose_decode_size(const loaded_video &video, const SDL_Rect &rect, int &width, int &height)
+{
+    // SDL_RenderCopy étire la texture sur dst_rect : on décode à cette taille, sans jamais dépasser celle du fichier
+    width = video.native_width;
+    height = video.native_height;
+    if (rect.w > 0 && rect.w < width)
+        width = rect.w;
+    if (rect.h > 0 && rect.h < height)
+        height = rect.h;
+
+    // Dimensions paires pour les conversions de chroma de VLC
+    width = std::max(2, width + (width & 1));
+    height = std::max(2, height + (height & 1));
+}
+
+
+void Video::configure_output(loaded_video &video)
+{
+    // Lecteur arrêté ou pas encore démarré : personne n'écrit dans le triple tampon
+    SDL_LockMutex(video.mutex.get());
+    SDL_Rect rect = *video.dst_rect;
+    SDL_UnlockMutex(video.mutex.get());
+
+    choose_decode_size(video, rect, video.decode_width, video.decode_height);
+
+    // Lignes alignées sur 32 octets pour les copies de VLC
+    video.pitch = (video.decode_width * 2 + 31) & ~31;
+    video.frames.resize(static_cast<size_t>(video.pitch) * video.decode_height);
+}
+
+
+bool Video::needs_renegotiation(const loaded_video &video)
+{
+    SDL_LockMutex(video.mutex.get());
+    SDL_Rect rect = *video.dst_rect;
+    SDL_UnlockMutex(video.mutex.get());
+
+    int width, height;
+    choose_decode_size(video, rect, width, height);
+
+    // Seul un changement de surface important justifie l'arrêt et la relance du décodeur
+    float ratio = float(width) * float(height) / (float(video.decode_width) * float(video.decode_height));
+    return ratio > m_renegotiation_ratio || ratio < 1.0f / m_renegotiation_ratio;
+}
+
+
+void Video::renegotiate(loaded_video &video)
+{
+    // Le format ne se change que lecteur arrêté : on relance la lecture à la même position
+    libvlc_time_t time = libvlc_media_player_get_time(video.mp.get());
+    libvlc_media_player_stop(video.mp.get());
+
+    configure_output(video);
+
+    libvlc_media_player_play(video.mp.get());
+    if (time > 0)
+        libvlc_media_player_set_time(video.mp.get(), time);
+    video.renegotiations++;
+}
+
+
+void Video::start_renegotiation(loaded_video &video)
+{
+    // Arrêter et relancer VLC peut prendre plusieurs dizaines de ms : jamais sur le thread de rendu ni sous Video_Mutex
+    video.renegotiating = true;
+    auto work = [this, &video]() {
+        std::lock_guard<std::mutex> lock(video.player_mtx);
+        renegotiate(video);
+        video.renegotiating = false;
+        // Sous le verrou : celui qui attend pour détruire la vidéo ne peut pas le faire avant qu'on l'ait relâché
+        video.player_cond.notify_all();
+    };
+
+    if (m_threads_workers)
+        m_threads_workers->submit_task(std::move(work));
+    else
+        std::thread(std::move(work)).detach();
+}
+
+
+std::unique_lock<std::mutex> Video::lock_player(loaded_video &video)
+{
+    // Attend la fin d'une renégociation, la vidéo peut ensuite être arrêtée ou détruite
+    std::unique_lock<std::mutex> lock(video.player_mtx);
+    video.player_cond.wait(lock, [&video]() { return !video.renegotiating.load(); });
+    return lock;
+}
+
+
+bool Video::recreate_texture(loaded_video &video)
+{
+    // Thread de rendu seulement, la texture suit la taille des images décodées
+    video.texture = std::unique_ptr<SDL_Texture, std::function<void(SDL_Texture *)>>(
             SDL_CreateTexture(
                     m_renderer,
                     SDL_PIXELFORMAT_BGR565, SDL_TEXTUREACCESS_STREAMING,
-                    static_cast<int>(w), static_cast<int>(h)
+                    video.decode_width, video.decode_height
             ), SDL_DestroyTexture
     );
+    if (!video.texture) {
+        std::cout << "Video texture could not be created : " << SDL_GetError() << std::endl;
+        video.texture_width = video.texture_height = 0;
+        return false;
+    }
 
-    // On attache la texture à la vidéo
-    libvlc_video_set_callbacks(context->mp.get(), lock, unlock, display, context.get());
-    libvlc_video_set_format(context->mp.get(), "RV16", w, h, w*2);
-    libvlc_media_player_play(context->mp.get());
+    video.texture_width = video.decode_width;
+    video.texture_height = video.decode_height;
+
+    // src_rect pour la taille de la texture
+    SDL_LockMutex(video.mutex.get());
+    *video.src_rect = SDL_Rect{0, 0, video.texture_width, video.texture_height};
+    SDL_UnlockMutex(video.mutex.get());
+    return true;
+}
 
-    // Changer le niveau du son à 100%
-    libvlc_audio_set_volume(context->mp.get(), 100);
-    // On désactive les logs de VLC
-    libvlc_log_set(vlc_player, log_null, nullptr);
 
-    // On libère la mémoire
-    libvlc_release(vlc_player);
+bool Video::load_video_with_id(const std::string &id, const std::string &path, SDL_Rect rect, std::vector<std::string> vec)
+{
+    // Le lecteur et sa texture ne sont créés que sur le thread de rendu : on charge comme load_video_async,
+    // puis on attend que update_loading_videos et update_video_frames aient fait passer la vidéo à READY ou FAILED
+    // Depuis le thread de rendu, personne ne ferait avancer le chargement pendant l'attente
+    if (std::this_thread::get_id() == m_render_thread.load()) {
+        std::cout << "Video " << id << " cannot be loaded synchronously from the render thread, use load_video_async" << std::endl;
+        return false;
+    }
 
+    Handle handle = load_video_async(id, path, rect, std::move(vec));
+    if (!handle.is_valid())
+        return false;
 
+    // Une vidéo supprimée pendant l'attente est vue comme FAILED, delete_video réveille l'attente
+    Video_state state = Video_state::LOADING;
     {
-        // On protège la liste des vidéos
-        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
-        size_t size = m_loaded_videos.size();
-        // On ajoute la vidéo à la liste
-        m_loaded_videos.push_back(std::move(context));
-        size_t new_size = m_loaded_videos.size();
-
-        // Si la taille de la liste a changé, alors on a ajouté un bouton
-        if (size != new_size) {
-            return true;
-        }
+        std::unique_lock<std::mutex> lock(m_state_mtx);
+        m_state_cond.wait_until(lock, std::chrono::steady_clock::now() + m_sync_load_timeout, [this, handle, &state]() {
+            state = return_video_state(handle);
+            return state != Video_state::LOADING;
+        });
+    }
+
+    if (state == Video_state::LOADING)
+        std::cout << "Video " << id << " did not start in time" << std::endl;
+
+    // Comme avant, une vidéo qui n'a pas pu démarrer n'est pas gardée
+    if (state != Video_state::READY) {
+        delete_video(handle);
         return false;
     }
+
+    return true;
 }
 
 bool Video::load_video_with_id(const std::string &id, const std::string &path, std::vector<std::string> vec)
@@ -154,37 +379,209 @@ bool Video::load_video_with_id(const std::string &id, const std::string &path, s
 }
 
 
+Handle Video::load_video_async(const std::string &id, const std::string &path, SDL_Rect rect, std::vector<std::string> vec, Video_state_callback on_state)
+{
+    {
+        // Un id ne peut désigner qu'une seule vidéo
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        if (m_loaded_videos.find(id).is_valid()) {
+            std::cout << "Video " << id << " already exists" << std::endl;
+            return Handle{};
+        }
+    }
+
+    // Seuls l'instance (déjà dans le pool en général) et le média sont créés ici, l'analyse part en arrière-plan
+    std::unique_ptr<loaded_video> context = create_video(id, path, rect, vec);
+    if (!context)
+        return Handle{};
+    context->on_state = std::move(on_state);
+
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        loaded_video *video = context.get();
+        handle = m_loaded_videos.insert(std::move(context), id);
+        if (handle.is_valid())
+            video->handle = handle;
+    }
+
+    if (!handle.is_valid())
+        std::cout << "Video " << id << " already exists" << std::endl;
+    return handle;
+}
+
+
+void Video::update_loading_videos()
+{
+    // Les textures SDL ne se créent que sur le thread du renderer : on démarre ici les vidéos analysées
+    m_render_thread.store(std::this_thread::get_id());
+    {
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        m_loaded_videos.for_each([this](Handle, std::unique_ptr<loaded_video> &video) {
+            if (video->parsed && !video->player_started)
+                start_player(*video);
+        });
+    }
+
+    notify_state_changes();
+}
+
+
+Video_state Video::return_video_state(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    std::unique_ptr<loaded_video> *video = m_loaded_videos.get(handle);
+    return video ? (*video)->state.load() : Video_state::FAILED;
+}
+
+
+std::shared_ptr<libvlc_instance_t> Video::acquire_instance(const std::vector<std::string> &arguments)
+{
+    // Si le vecteur est vide, on utilise les arguments par défaut
+    std::vector<std::string> vlc_arguments = arguments;
+    if (vlc_arguments.empty())
+        vlc_arguments = {
+            //"--no-audio", // Don't play audio.
+            "--no-xlib", // Don't use Xlib.
+        };
+
+    // La clé est le jeu d'arguments, dans l'ordre donné
+    std::string key;
+    for (const auto &argument : vlc_arguments)
+    {
+        key += argument;
+        key += '\n';
+    }
+
+    std::lock_guard<std::mutex> lock(m_instances_mtx);
+    auto it = m_instances.find(key);
+    if (it != m_instances.end())
+        return it->second;
+
+    // Tableau de pointeurs const char* pour les arguments de VLC
+    std::vector<const char *> vlc_argv;
+    vlc_argv.reserve(vlc_arguments.size());
+    for (const auto &argument : vlc_arguments)
+        vlc_argv.push_back(argument.c_str());
+
+    // Initialise libVLC, une seule fois pour ce jeu d'arguments
+    libvlc_instance_t *instance = libvlc_new(static_cast<int>(vlc_argv.size()), vlc_argv.data());
+    if (!instance)
+        return nullptr;
+
+    // On désactive les logs de VLC
+    libvlc_log_set(instance, log_null, nullptr);
+    m_load_statistics.instances_created++;
+
+    std::shared_ptr<libvlc_instance_t> shared_instance(instance, libvlc_release);
+    m_instances.emplace(key, shared_instance);
+    return shared_instance;
+}
+
+
+int64_t Video::return_resident_memory()
+{
+    // Mémoire résidente du processus en octets (Linux), 0 si elle n'est pas disponible
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0, resident = 0;
+    if (!(statm >> size >> resident))
+        return 0;
+
+    return resident * static_cast<int64_t>(sysconf(_SC_PAGESIZE));
+}
+
+
+void Video::release_unused_instances()
+{
+    // Une instance qui n'est plus tenue que par le pool ne sert à aucune vidéo
+    std::lock_guard<std::mutex> lock(m_instances_mtx);
+    for (auto it = m_instances.begin(); it != m_instances.end();)
+    {
+        if (it->second.use_count() == 1)
+            it = m_instances.erase(it);
+        else
+            ++it;
+    }
+}
+
+
+Video_load_statistics Video::return_load_statistics()
+{
+    std::lock_guard<std::mutex> lock(m_instances_mtx);
+    Video_load_statistics statistics = m_load_statistics;
+    statistics.instances = m_instances.size();
+    return statistics;
+}
+
+
 void Video::log_null([[maybe_unused]] void *data, [[maybe_unused]] int level, [[maybe_unused]] const libvlc_log_t *ctx, [[maybe_unused]] const char *fmt, [[maybe_unused]]va_list args)
 {
     // Ne fait rien pour eviter le message libvlc parasite
 }
 
 
-void Video::media_parsed_changed(const libvlc_event_t* event, [[maybe_unused]] void* data)
+void Video::media_parsed_changed(const libvlc_event_t* event, void* data)
 {
-    if (event->u.media_parsed_changed.new_status == libvlc_media_parsed_status_done) {
-        // Il se passe rien, le parsing est fini
-    }
+    // Thread de VLC : on note seulement le résultat, appeler libvlc depuis un de ses événements peut bloquer
+    auto *c = (loaded_video *)data;
+    c->parsed_status = event->u.media_parsed_changed.new_status;
+    c->parsed = true;
+
+    // Le thread de rendu démarrera le lecteur à sa prochaine frame
+    if (c->frame_invalidation)
+        c->frame_invalidation->invalidate();
+}
+
+
+void Video::player_event(const libvlc_event_t* event, void* data)
+{
+    // Thread de VLC : comme pour l'analyse, on note seulement l'événement, le thread de rendu décide de l'état
+    auto *c = (loaded_video *)data;
+    if (event->type == libvlc_MediaPlayerEncounteredError)
+        c->player_error = true;
+    else if (event->type == libvlc_MediaPlayerEndReached)
+        c->player_ended = true;
+
+    if (c->frame_invalidation)
+        c->frame_invalidation->invalidate();
+}
+
+
+unsigned Video::format_setup(void **opaque, char *chroma, unsigned *width, unsigned *height, unsigned *pitches, unsigned *lines)
+{
+    // Thread de VLC : 'width' et 'height' arrivent à la taille du fichier, on demande la taille choisie par le rendu
+    auto *c = (loaded_video *)*opaque;
+
+    memcpy(chroma, "RV16", 4);
+    *width = static_cast<unsigned>(c->decode_width);
+    *height = static_cast<unsigned>(c->decode_height);
+    pitches[0] = static_cast<unsigned>(c->pitch);
+    lines[0] = static_cast<unsigned>(c->decode_height);
+
+    // Un seul plan, VLC met l'image à l'échelle avant lock
+    return 1;
 }
 
+void Video::format_cleanup([[maybe_unused]] void *opaque)
+{
+    // Les tampons appartiennent au triple tampon, rien à libérer
+}
 
 void *Video::lock(void *data, void **p_pixels)
 {
     // On récupère le contexte de la vidéo
     auto *c = (loaded_video *)data;
 
-    // On lock le mutex
-    int pitch;
-    SDL_LockMutex(c->mutex.get());
-    SDL_LockTexture(c->texture.get(), nullptr, p_pixels, &pitch);
+    // Le décodeur écrit dans son propre tampon, sans verrou : le rendu ne l'attend jamais
+    *p_pixels = c->frames.return_write_buffer();
 
     return nullptr; // Picture identifier, not needed here.
 }
 
 void Video::unlock(void *data, [[maybe_unused]] void *id, [[maybe_unused]] void *const *p_pixels)
 {
-    // On récupère le contexte de la vidéo
-    auto *c = (loaded_video *)data;
+    // On récupère le contexte de la vidéo, l'image est dans son tampon d'écriture jusqu'à display
+    [[maybe_unused]] auto *c = (loaded_video *)data;
 
     // Ici on peut aussi dessiner des trucs.
     // On peut edit les pixels de la vidéo
@@ -220,75 +617,260 @@ void Video::unlock(void *data, [[maybe_unused]] void *id, [[maybe_unused]] void
     memcpy(pixels, copied_pixels, total_pixels * sizeof(uint16_t));
 
     delete[] copied_pixels;*/
-
-    // On unlock la texture
-    SDL_UnlockTexture(c->texture.get());
-    SDL_UnlockMutex(c->mutex.get());
 }
 
 void Video::display(void *data, [[maybe_unused]] void *id)
 {
-    [[maybe_unused]] auto *c = (loaded_video *)data; // On fait rien ici mais c'est utilisé pour le callback
+    auto *c = (loaded_video *)data;
+
+    // L'image devient la dernière image prête, une image encore non prise est remplacée
+    // La vidéo ne devient visible (READY) qu'après l'envoi de cette image à sa texture, par le thread de rendu
+    c->frames.publish();
+
+    // Une nouvelle image est prête, la boucle de rendu doit redessiner
+    if (c->frame_invalidation)
+        c->frame_invalidation->invalidate();
+}
+
+void Video::set_frame_invalidation(Frame_invalidation *frame_invalidation)
+{
+    // Les vidéos chargées ensuite invalideront la frame à chaque nouvelle image
+    m_frame_invalidation = frame_invalidation;
+}
+
+void Video::set_damage_tracker(Damage_tracker *damage_tracker)
+{
+    // Les vidéos chargées ensuite signaleront leur zone à chaque nouvelle image
+    m_damage_tracker = damage_tracker;
+}
+
+void Video::set_threads_workers(ThreadsWorkers *threads_workers)
+{
+    // Les renégociations de format passent par le pool au lieu d'un thread dédié
+    m_threads_workers = threads_workers;
 }
 
 void Video::display_video_all_video()
 {
     // On affiche toutes les vidéos
-    for (auto &video : m_loaded_videos)
-    {
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+
+    // Appelée une fois par zone abîmée, le clip du renderer est cette zone
+    SDL_Rect clip{0, 0, 0, 0};
+    bool has_clip = SDL_RenderIsClipEnabled(m_renderer);
+    if (has_clip)
+        SDL_RenderGetClipRect(m_renderer, &clip);
+
+    m_loaded_videos.for_each([this, has_clip, &clip](Handle, std::unique_ptr<loaded_video> &video) {
+        // Rien n'est affiché avant que la première image soit dans la texture, une vidéo en cours de chargement ne bloque jamais la frame
+        if (video->state != Video_state::READY)
+            return;
+
         SDL_LockMutex(video->mutex.get());
-        SDL_RenderCopy(m_renderer, video->texture.get(), video->src_rect.get(), video->dst_rect.get());
+        SDL_Rect src_rect = *video->src_rect;
+        SDL_Rect dst_rect = *video->dst_rect;
         SDL_UnlockMutex(video->mutex.get());
+
+        // La zone recomposée ne touche pas la vidéo : rien à copier
+        if (has_clip && !SDL_HasIntersection(&clip, &dst_rect))
+            return;
+
+        SDL_RenderCopy(m_renderer, video->texture.get(), &src_rect, &dst_rect);
+    });
+}
+
+void Video::update_video_frames()
+{
+    {
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        m_loaded_videos.for_each([this](Handle, std::unique_ptr<loaded_video> &video) {
+            if (!video->player_started || video->state == Video_state::FAILED)
+                return;
+
+            // Renégociation en cours : la texture actuelle reste affichée en attendant les images à la nouvelle taille
+            if (video->renegotiating)
+                return;
+
+            // Gros changement de taille : le décodeur repart à la nouvelle taille dans le pool
+            if (video->size_changed)
+            {
+                video->size_changed = false;
+                if (needs_renegotiation(*video))
+                {
+                    start_renegotiation(*video);
+                    return;
+                }
+            }
+
+            // Lu avant take() : une image publiée avant l'erreur ou la fin est forcément vue par take()
+            bool player_stopped = video->player_error || video->player_ended;
+
+            // Pas de nouvelle image : ni envoi à la texture ni zone abîmée, la vidéo n'est pas recomposée
+            if (!video->frames.take())
+            {
+                // Lecteur en erreur ou à la fin sans avoir jamais produit d'image : la vidéo ne sera jamais affichée
+                if (player_stopped && video->state == Video_state::LOADING)
+                {
+                    std::cout << "Video " << *video->path << " could not be decoded" << std::endl;
+                    set_state(*video, Video_state::FAILED);
+                }
+                return;
+            }
+
+            // Première image à la nouvelle taille
+            if ((video->texture_width != video->decode_width || video->texture_height != video->decode_height) && !recreate_texture(*video))
+                return;
+
+            SDL_UpdateTexture(video->texture.get(), nullptr, video->frames.return_read_buffer(), video->pitch);
+            video->uploaded++;
+
+            // Première image envoyée : la texture est écrite, la vidéo peut être dessinée
+            if (video->state == Video_state::LOADING)
+                set_state(*video, Video_state::READY);
+
+            // Seule la zone de la vidéo est à recomposer
+            if (video->damage_tracker)
+            {
+                SDL_LockMutex(video->mutex.get());
+                SDL_Rect rect = *video->dst_rect;
+                SDL_UnlockMutex(video->mutex.get());
+                video->damage_tracker->add_damage(rect);
+            }
+        });
     }
+
+    notify_state_changes();
 }
 
 void Video::stop_all_video()
 {
     // On stoppe toutes les vidéos
-    for (auto &video : m_loaded_videos)
-    {
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    m_loaded_videos.for_each([](Handle, std::unique_ptr<loaded_video> &video) {
+        if (!video->mp)
+            return;
+        std::unique_lock<std::mutex> player_lock = lock_player(*video);
         libvlc_media_player_stop(video->mp.get());
-    }
+    });
 }
 
-bool Video::edit_video_with_id(const std::string &id, SDL_Rect rect)
+Handle Video::return_video_handle(const std::string &id)
 {
+    // Recherche par nom en O(1), la poignée permet ensuite d'accéder à la vidéo sans comparer de texte
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    return m_loaded_videos.find(id);
+}
 
+bool Video::edit_video_with_id(const std::string &id, SDL_Rect rect)
+{
     // On édite la vidéo avec l'identifiant id
-    for (auto &video : m_loaded_videos)
+    return edit_video(return_video_handle(id), rect);
+}
+
+bool Video::edit_video(Handle handle, SDL_Rect rect)
+{
     {
-        if (*video->id == id)
-        {
-            SDL_LockMutex(video->mutex.get());
-            *video->dst_rect = rect;
-            SDL_UnlockMutex(video->mutex.get());
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        std::unique_ptr<loaded_video> *video = m_loaded_videos.get(handle);
+        if (!video)
+            return false;
+
+        SDL_LockMutex((*video)->mutex.get());
+        SDL_Rect previous_rect = *(*video)->dst_rect;
+        *(*video)->dst_rect = rect;
+        SDL_UnlockMutex((*video)->mutex.get());
 
-            return true;
+        // La taille de décodage sera revue par le thread de rendu
+        if (previous_rect.w != rect.w || previous_rect.h != rect.h)
+            (*video)->size_changed = true;
+
+        // L'ancienne zone doit être effacée, la nouvelle dessinée
+        if (m_damage_tracker)
+        {
+            m_damage_tracker->add_damage(previous_rect);
+            m_damage_tracker->add_damage(rect);
         }
     }
 
-    return false;
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+
+    return true;
 }
 
 
 bool Video::delete_video_with_id(const std::string &id)
 {
     // On supprime la vidéo avec l'identifiant id
-    for (auto it = m_loaded_videos.begin(); it != m_loaded_videos.end(); ++it)
+    return delete_video(return_video_handle(id));
+}
+
+bool Video::delete_video(Handle handle)
+{
+    // On retire la vidéo de la liste sous le verrou, mais on l'arrête en dehors car l'arrêt de VLC peut être long
+    std::optional<std::unique_ptr<loaded_video>> video;
     {
-        if (*(*it)->id == id)
-        {
-            libvlc_media_player_stop((*it)->mp.get());
-            m_loaded_videos.erase(it);
-            return true;
-        }
+        std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+        video = m_loaded_videos.take(handle);
+    }
+
+    if (!video)
+        return false;
+
+    // Un chargement synchrone qui attendait cette vidéo la voit maintenant comme FAILED
+    {
+        std::lock_guard<std::mutex> lock(m_state_mtx);
+    }
+    m_state_cond.notify_all();
+
+    if ((*video)->mp)
+    {
+        std::unique_lock<std::mutex> player_lock = lock_player(**video);
+        libvlc_media_player_stop((*video)->mp.get());
     }
+    if (m_damage_tracker)
+        m_damage_tracker->add_damage(*(*video)->dst_rect);
+    video.reset();
 
-    return false;
+    if (m_frame_invalidation)
+        m_frame_invalidation->invalidate();
+    return true;
 }
 
 uint32_t Video::get_number_of_video()
 {
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
     return static_cast<uint32_t>(m_loaded_videos.size());
 }
 
+
+Video_frame_statistics Video::return_frame_statistics(Handle handle)
+{
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    Video_frame_statistics statistics;
+    std::unique_ptr<loaded_video> *video = m_loaded_videos.get(handle);
+    if (!video)
+        return statistics;
+
+    statistics.published = (*video)->frames.return_published_count();
+    statistics.uploaded = (*video)->uploaded;
+    statistics.dropped = (*video)->frames.return_dropped_count();
+    statistics.repeated = (*video)->frames.return_repeated_count();
+    statistics.renegotiations = (*video)->renegotiations;
+    return statistics;
+}
+
+
+Video_frame_statistics Video::return_frame_statistics()
+{
+    std::lock_guard<std::mutex> lock(Video_Mutex::mtx);
+    Video_frame_statistics statistics;
+    m_loaded_videos.for_each([&statistics](Handle, std::unique_ptr<loaded_video> &video) {
+        statistics.published += video->frames.return_published_count();
+        statistics.uploaded += video->uploaded;
+        statistics.dropped += video->frames.return_dropped_count();
+        statistics.repeated += video->frames.return_repeated_count();
+        statistics.renegotiations += video->renegotiations;
+    });
+    return statistics;
+}
@@ -15,11 +15,59 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
 #include <functional>
+#include <unordered_map>
 #include <iostream>
 
 #include "../main_prog/data.hpp"
+#include "../frame/frame_invalidation.hpp"
+#include "../frame/damage_tracker.hpp"
+#include "../registry/registry.hpp"
+#include "frame_exchange.hpp"
+
+class ThreadsWorkers;
+
+// Mesures du chargement des vidéos, pour comparer les réglages de VLC
+struct Video_load_statistics
+{
+    uint64_t loads = 0;
+    uint64_t instances_created = 0;     // Appels à libvlc_new depuis le début
+    size_t instances = 0;               // Instances gardées dans le pool
+
+    double last_load_ms = 0.0;          // Durée du dernier chargement (parsing compris)
+    double mean_load_ms = 0.0;
+    int64_t last_load_rss_bytes = 0;    // Mémoire résidente du processus prise par le dernier chargement
+    double mean_load_rss_bytes = 0.0;
+};
+
+
+// Échanges d'images entre le décodeur et le rendu
+struct Video_frame_statistics
+{
+    uint64_t published = 0;     // Images décodées
+    uint64_t uploaded = 0;      // Images envoyées à la texture
+    uint64_t dropped = 0;       // Images remplacées par une plus récente avant d'être affichées
+    uint64_t repeated = 0;      // Passages de update_video_frames() sans nouvelle image, présentés ou non : un compte de ticks de rendu,
+                                // pas d'images montrées deux fois (à 120 Hz, une vidéo à 25 i/s en ajoute environ 95 par seconde)
+    uint64_t renegotiations = 0;    // Changements de taille de décodage après un redimensionnement
+};
+
+
+// État d'une vidéo chargée de façon asynchrone
+enum class Video_state
+{
+    LOADING,    // Analyse du média ou démarrage du lecteur en cours, rien n'est affiché
+    READY,      // Première image envoyée à la texture, la vidéo est affichée
+    FAILED      // Média illisible, sans piste vidéo, ou lecteur en erreur (ou à la fin) avant sa première image
+};
+
+// Appelée sur le thread de rendu au passage à READY ou à FAILED, sans verrou : elle peut rappeler Video mais ne doit pas bloquer
+using Video_state_callback = std::function<void(Handle, Video_state)>;
+
 
 class Video {
 private:
@@ -27,37 +75,156 @@ private:
         std::unique_ptr<std::string> id;
         std::unique_ptr<std::string> path;
 
-        std::unique_ptr<libvlc_media_player_t, std::function<void(libvlc_media_player_t *)>> mp;
+        // Instance partagée, déclarée avant le lecteur pour être libérée après lui
+        std::shared_ptr<libvlc_instance_t> instance;
 
         std::unique_ptr<SDL_Texture, std::function<void(SDL_Texture *)>> texture;
+        // Protège les rectangles, le décodeur n'y touche jamais
         std::unique_ptr<SDL_mutex, std::function<void(SDL_mutex *)>> mutex;
         std::unique_ptr<SDL_Rect> dst_rect;
         std::unique_ptr<SDL_Rect> src_rect;
+
+        // Invalidée à chaque nouvelle image décodée
+        Frame_invalidation *frame_invalidation;
+        // Reçoit la zone de la vidéo à chaque nouvelle image décodée
+        Damage_tracker *damage_tracker;
+
+        // Images décodées, envoyées à la texture par le thread de rendu seulement
+        Frame_exchange frames;
+        int pitch = 0;
+
+        // Taille du fichier, taille demandée au décodeur (celle de dst_rect, au plus la taille du fichier) et taille de la texture
+        // decode_width et decode_height ne changent que lecteur arrêté, le callback de format les lit sur le thread de VLC
+        int native_width = 0;
+        int native_height = 0;
+        int decode_width = 0;
+        int decode_height = 0;
+        int texture_width = 0;
+        int texture_height = 0;
+        // dst_rect a changé de taille depuis la dernière frame
+        bool size_changed = false;
+        std::atomic<uint64_t> renegotiations = 0;
+        // Renégociation en cours dans le pool : le thread de rendu garde l'ancienne texture sans rien lire du triple tampon
+        // player_mtx est tenu pendant les appels à libvlc, l'arrêt et la destruction attendent la fin sur player_cond
+        std::atomic<bool> renegotiating = false;
+        std::mutex player_mtx;
+        std::condition_variable player_cond;
+        uint64_t uploaded = 0;
+
+        // Chargement asynchrone : l'événement de fin d'analyse ne fait que noter le résultat,
+        // le lecteur est démarré ensuite par le thread de rendu, même pour un chargement synchrone
+        Handle handle;
+        std::atomic<Video_state> state = Video_state::LOADING;
+        std::atomic<bool> parsed = false;
+        std::atomic<bool> player_started = false;
+        std::atomic<int> parsed_status = 0;
+        // Notés par les événements du lecteur sur le thread de VLC : sans image reçue, la vidéo passe à FAILED
+        std::atomic<bool> player_error = false;
+        std::atomic<bool> player_ended = false;
+        Video_state_callback on_state;
+        std::chrono::steady_clock::time_point load_start;
+        int64_t load_resident_memory = 0;
+
+        // Déclarés en dernier pour être libérés en premier, avant la texture et le mutex utilisés par leurs callbacks
+        std::unique_ptr<libvlc_media_t, std::function<void(libvlc_media_t *)>> media;
+        std::unique_ptr<libvlc_media_player_t, std::function<void(libvlc_media_player_t *)>> mp;
     };
 
-    std::vector<std::unique_ptr<loaded_video>> m_loaded_videos;
+    // Les vidéos sont rangées par poignée, l'id texte n'est plus qu'un nom pour les retrouver
+    Registry<std::unique_ptr<loaded_video>> m_loaded_videos;
     SDL_Renderer *m_renderer;
+    Frame_invalidation *m_frame_invalidation = nullptr;
+    Damage_tracker *m_damage_tracker = nullptr;
+    ThreadsWorkers *m_threads_workers = nullptr;
+
+    // Instances libvlc réutilisées d'un chargement à l'autre, une par jeu d'arguments
+    // libvlc_new charge le cache des plugins et les modules, on ne le paie qu'une fois par jeu
+    std::unordered_map<std::string, std::shared_ptr<libvlc_instance_t>> m_instances;
+    std::mutex m_instances_mtx;
+    Video_load_statistics m_load_statistics;
+
+    // Rapport de surface entre la taille décodée et la taille affichée au-delà duquel on renégocie le format
+    static constexpr float m_renegotiation_ratio = 1.5f;
+
+    // Changements d'état notés sous Video_Mutex, les callbacks sont appelés une fois le verrou relâché
+    // pour pouvoir rappeler n'importe quelle fonction de Video
+    struct State_change {
+        Video_state_callback callback;
+        Handle handle;
+        Video_state state;
+    };
+    std::vector<State_change> m_state_changes;
+    // Réveille les chargements synchrones qui attendent READY ou FAILED, ou la suppression de leur vidéo
+    std::mutex m_state_mtx;
+    std::condition_variable m_state_cond;
+    // Thread qui démarre les lecteurs (celui du renderer) : un chargement synchrone ne doit jamais l'attendre depuis lui-même
+    std::atomic<std::thread::id> m_render_thread;
+    // Délai maximal d'un chargement synchrone, une vidéo qui n'a toujours pas sa première image est abandonnée
+    static constexpr std::chrono::seconds m_sync_load_timeout{10};
 
 private:
+    std::shared_ptr<libvlc_instance_t> acquire_instance(const std::vector<std::string> &arguments);
+    std::unique_ptr<loaded_video> create_video(const std::string &id, const std::string &path, SDL_Rect rect, const std::vector<std::string> &vec);
+    bool start_player(loaded_video &video);
+    void record_load(const loaded_video &video);
+    void set_state(loaded_video &video, Video_state state);
+    void notify_state_changes();
+    static void choose_decode_size(const loaded_video &video, const SDL_Rect &rect, int &width, int &height);
+    void configure_output(loaded_video &video);
+    bool needs_renegotiation(const loaded_video &video);
+    void renegotiate(loaded_video &video);
+    void start_renegotiation(loaded_video &video);
+    static std::unique_lock<std::mutex> lock_player(loaded_video &video);
+    bool recreate_texture(loaded_video &video);
+    static int64_t return_resident_memory();
+
     static void *lock(void *data, void **p_pixels);
     static void unlock(void *data, void *id, void *const *p_pixels);
     static void display(void *data, void *id);
+    static unsigned format_setup(void **opaque, char *chroma, unsigned *width, unsigned *height, unsigned *pitches, unsigned *lines);
+    static void format_cleanup(void *opaque);
 
     static void log_null( void *data, int level, const libvlc_log_t *ctx, const char *fmt, va_list args);
     static void media_parsed_changed(const libvlc_event_t* event, void* data);
+    static void player_event(const libvlc_event_t* event, void* data);
 
 public:
     explicit Video(SDL_Renderer *renderer);
-    ~Video() = default;
+    ~Video();
 
+    // Version bloquante de load_video_async : attend que le thread de rendu ait démarré la vidéo (READY) ou abandonné (FAILED)
+    // Renvoie false sans rien charger si elle est appelée depuis le thread de rendu (callback MAIN_THREAD compris)
     bool load_video_with_id(const std::string &id, const std::string &path, SDL_Rect rect, std::vector<std::string> vec = {});
     bool load_video_with_id(const std::string &id, const std::string &path, std::vector<std::string> vec = {});
+    // Rend la main tout de suite : analyse en arrière-plan, la vidéo s'affiche à sa première image
+    // La poignée est invalide si l'id existe déjà ou si VLC n'a pas pu démarrer
+    Handle load_video_async(const std::string &id, const std::string &path, SDL_Rect rect = {0, 0, 0, 0},
+                            std::vector<std::string> vec = {}, Video_state_callback on_state = {});
+    // Thread de rendu, une fois par frame : crée textures et lecteurs des vidéos dont l'analyse est terminée
+    void update_loading_videos();
+    // Thread de rendu, une fois par frame : envoie à leur texture les dernières images décodées et signale leur zone
+    void update_video_frames();
+    [[nodiscard]] Video_state return_video_state(Handle handle);
+    void set_frame_invalidation(Frame_invalidation *frame_invalidation);
+    void set_damage_tracker(Damage_tracker *damage_tracker);
+    void set_threads_workers(ThreadsWorkers *threads_workers);
     void display_video_all_video();
     void stop_all_video();
     bool edit_video_with_id(const std::string &id, SDL_Rect rect);
     bool delete_video_with_id(const std::string &id);
+
+    [[nodiscard]] Handle return_video_handle(const std::string &id);
+    bool edit_video(Handle handle, SDL_Rect rect);
+    bool delete_video(Handle handle);
     uint32_t get_number_of_video();
 
+    // Libère les instances qui ne servent plus à aucune vidéo
+    void release_unused_instances();
+    [[nodiscard]] Video_load_statistics return_load_statistics();
+    // Pour une vidéo, ou pour toutes avec la version sans paramètre
+    [[nodiscard]] Video_frame_statistics return_frame_statistics(Handle handle);
+    [[nodiscard]] Video_frame_statistics return_frame_statistics();
+
 };
 
 
@@ -0,0 +1,273 @@
+//
+// Created by dell_nicolas on 31/05/24.
+//
+
+// Vérification et mesure des noyaux de pixels, hors du programme principal
+//   simd_kernels test  : chaque niveau SIMD disponible doit donner les mêmes octets que le scalaire
+//   simd_kernels bench : débit en MPix/s de chaque noyau et de chaque primitive du framebuffer, par niveau
+// Lancé par "make simd-test" et "make simd-bench"
+
+#include <SDL2/SDL.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/draw/framebuffer.hpp"
+#include "../src/draw/pixel_kernels.hpp"
+
+
+namespace {
+
+    const Simd_level simd_levels[] = {Simd_level::SCALAR, Simd_level::SSE4, Simd_level::AVX2, Simd_level::NEON};
+
+    const char *level_name(Simd_level level)
+    {
+        switch (level)
+        {
+            case Simd_level::SSE4: return "sse4";
+            case Simd_level::AVX2: return "avx2";
+            case Simd_level::NEON: return "neon";
+            case Simd_level::SCALAR:
+            default: return "scalar";
+        }
+    }
+
+    // Couleurs qui passent par tous les chemins du mélange : transparente, opaque, alpha extrêmes et quelconques
+    std::vector<uint32_t> test_colors(std::mt19937 &random)
+    {
+        std::vector<uint32_t> colors = {0x00000000u, 0xFFFFFFFFu, 0xFF000000u, 0x01FFFFFFu, 0xFE123456u, 0x80FF8040u, 0x7F00FF00u};
+        for (int i = 0; i < 16; i++)
+            colors.push_back(random());
+        return colors;
+    }
+
+    void fill_random(std::vector<uint32_t> &pixels, std::mt19937 &random)
+    {
+        for (auto &pixel : pixels)
+            pixel = random();
+    }
+
+    bool report(bool ok, const std::string &what, Simd_level level)
+    {
+        if (!ok)
+            std::printf("FAIL %-6s %s\n", level_name(level), what.c_str());
+        return ok;
+    }
+
+
+    // Noyaux de ligne : toutes les longueurs de 0 à 131 et tous les décalages de 0 à 7 pixels,
+    // pour couvrir les débuts non alignés et les restes qui ne remplissent pas un registre
+    bool test_spans(const Pixel_kernels &scalar, const Pixel_kernels &kernels)
+    {
+        std::mt19937 random(42);
+        std::vector<uint32_t> colors = test_colors(random);
+        std::vector<uint32_t> reference(160), result(160), src(1024);
+        fill_random(src, random);
+        bool ok = true;
+
+        for (size_t offset = 0; offset < 8; offset++)
+        {
+            for (size_t count = 0; count < 132; count++)
+            {
+                for (uint32_t color : colors)
+                {
+                    fill_random(reference, random);
+                    result = reference;
+                    scalar.fill_span(reference.data() + offset, count, color);
+                    kernels.fill_span(result.data() + offset, count, color);
+                    ok &= report(reference == result, "fill_span count=" + std::to_string(count) + " offset=" + std::to_string(offset), kernels.level);
+
+                    fill_random(reference, random);
+                    result = reference;
+                    scalar.blend_span(reference.data() + offset, count, color);
+                    kernels.blend_span(result.data() + offset, count, color);
+                    ok &= report(reference == result, "blend_span count=" + std::to_string(count) + " offset=" + std::to_string(offset), kernels.level);
+                }
+
+                // Agrandissement, réduction, pas non entiers et départ au milieu d'un pixel source
+                for (uint32_t x_step : {0x4000u, 0x8000u, 0x10000u, 0x12345u, 0x18000u, 0x30000u})
+                {
+                    for (uint32_t x_start : {0x0u, 0x8000u, 0x2FFFFu})
+                    {
+                        fill_random(reference, random);
+                        result = reference;
+                        scalar.blit_span_scaled(reference.data() + offset, count, src.data(), x_start, x_step);
+                        kernels.blit_span_scaled(result.data() + offset, count, src.data(), x_start, x_step);
+                        ok &= report(reference == result, "blit_span_scaled count=" + std::to_string(count) + " offset=" + std::to_string(offset) + " step=" + std::to_string(x_step), kernels.level);
+                    }
+                }
+            }
+        }
+        return ok;
+    }
+
+
+    // Scène qui passe par toutes les primitives du framebuffer, en partie hors de l'image et avec des couleurs translucides
+    void draw_scene(Framebuffer &framebuffer, const std::vector<uint32_t> &image, int image_width, int image_height, uint32_t seed)
+    {
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<int> coordinate(-40, 380);
+        std::uniform_int_distribution<int> size(0, 150);
+        std::uniform_int_distribution<int> radius(0, 60);
+        auto color = [&random]() { return uint32_t(random()); };
+
+        framebuffer.clear(0xFF202020u);
+        for (int i = 0; i < 40; i++)
+        {
+            framebuffer.fill_rect({coordinate(random), coordinate(random), size(random), size(random)}, color());
+            framebuffer.draw_rect_outline({coordinate(random), coordinate(random), size(random), size(random)}, 1 + radius(random) / 10, color());
+            framebuffer.fill_rounded_rect({coordinate(random), coordinate(random), size(random), size(random)}, radius(random), color());
+            framebuffer.fill_circle(coordinate(random), coordinate(random), radius(random), color());
+            framebuffer.fill_triangle({float(coordinate(random)), float(coordinate(random))}, {float(coordinate(random)), float(coordinate(random))},
+                                      {float(coordinate(random)), float(coordinate(random))}, color());
+            framebuffer.draw_line(coordinate(random), coordinate(random), coordinate(random), coordinate(random), color());
+            framebuffer.draw_line(coordinate(random), 17, coordinate(random), 17, color());
+            framebuffer.draw_point(coordinate(random), coordinate(random), color());
+            framebuffer.blit_scaled(image.data(), image_width, image_height, image_width,
+                                    {coordinate(random), coordinate(random), 1 + size(random), 1 + size(random)});
+        }
+    }
+
+    // Primitives complètes : même scène dessinée avec chaque niveau, largeur impaire pour les restes de fin de ligne
+    bool test_framebuffer(SDL_Renderer *renderer, const Pixel_kernels &scalar, const Pixel_kernels &kernels)
+    {
+        const int width = 333, height = 197;
+        std::mt19937 random(7);
+        std::vector<uint32_t> image(37 * 23);
+        fill_random(image, random);
+
+        Framebuffer reference(renderer, scalar), result(renderer, kernels);
+        if (!reference.resize(width, height, 0xFF000000u) || !result.resize(width, height, 0xFF000000u))
+        {
+            std::printf("Framebuffer could not be created : %s\n", SDL_GetError());
+            return false;
+        }
+
+        bool ok = true;
+        for (uint32_t seed = 1; seed <= 8; seed++)
+        {
+            draw_scene(reference, image, 37, 23, seed);
+            draw_scene(result, image, 37, 23, seed);
+            ok &= report(std::memcmp(reference.return_pixels(), result.return_pixels(), size_t(width) * height * sizeof(uint32_t)) == 0,
+                         "framebuffer scene seed=" + std::to_string(seed), kernels.level);
+        }
+        return ok;
+    }
+
+
+    // Débit en MPix/s d'un travail qui touche 'pixels' pixels par appel, mesuré sur au moins 200 ms
+    double measure(uint64_t pixels, const std::function<void()> &work)
+    {
+        work();
+        uint64_t iterations = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{0};
+        do
+        {
+            work();
+            iterations++;
+            elapsed = std::chrono::steady_clock::now() - start;
+        } while (elapsed.count() < 0.2);
+        return double(pixels) * double(iterations) / elapsed.count() / 1e6;
+    }
+
+    void bench_level(SDL_Renderer *renderer, const Pixel_kernels &kernels)
+    {
+        const int width = 1920, height = 1080;
+        const uint64_t frame = uint64_t(width) * height;
+        std::mt19937 random(3);
+        std::vector<uint32_t> pixels(frame), image(1280 * 720);
+        fill_random(image, random);
+
+        auto row_by_row = [&](const std::function<void(uint32_t *)> &row) {
+            return [&, row]() {
+                for (int y = 0; y < height; y++)
+                    row(&pixels[size_t(y) * width]);
+            };
+        };
+
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "fill_span",
+                    measure(frame, row_by_row([&](uint32_t *dst) { kernels.fill_span(dst, width, 0xFF336699u); })));
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "blend_span",
+                    measure(frame, row_by_row([&](uint32_t *dst) { kernels.blend_span(dst, width, 0x80336699u); })));
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "blit_span_scaled",
+                    measure(frame, row_by_row([&](uint32_t *dst) { kernels.blit_span_scaled(dst, width, image.data(), 0, (1280u << 16) / width); })));
+
+        Framebuffer framebuffer(renderer, kernels);
+        if (!framebuffer.resize(width, height, 0xFF000000u))
+            return;
+
+        // 64 rectangles arrondis translucides de 400 x 300
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "rounded_rect", measure(64 * 400 * 300, [&]() {
+            for (int i = 0; i < 64; i++)
+                framebuffer.fill_rounded_rect({(i * 23) % 1500, (i * 13) % 700, 400, 300}, 40, 0xC0806040u);
+            framebuffer.rasterize();
+        }));
+
+        // 2000 lignes diagonales de 1001 pixels
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "line", measure(2000 * 1001, [&]() {
+            for (int i = 0; i < 2000; i++)
+                framebuffer.draw_line(i % 900, 0, i % 900 + 1000, 1000, 0xFF40C080u);
+            framebuffer.rasterize();
+        }));
+
+        // Image 1280 x 720 agrandie à toute l'image
+        std::printf("%-6s %-16s %10.1f MPix/s\n", level_name(kernels.level), "blit_scaled", measure(frame, [&]() {
+            framebuffer.blit_scaled(image.data(), 1280, 720, 1280, {0, 0, width, height});
+            framebuffer.rasterize();
+        }));
+    }
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "test";
+    if (mode != "test" && mode != "bench")
+    {
+        std::printf("usage: %s [test|bench]\n", argv[0]);
+        return 2;
+    }
+
+    // Renderer logiciel sur une surface : pas besoin de fenêtre ni d'affichage
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+    if (!renderer)
+    {
+        std::printf("Software renderer could not be created : %s\n", SDL_GetError());
+        return 1;
+    }
+
+    const Pixel_kernels &scalar = *return_pixel_kernels(Simd_level::SCALAR);
+    bool ok = true;
+    for (Simd_level level : simd_levels)
+    {
+        const Pixel_kernels *kernels = return_pixel_kernels(level);
+        if (!kernels)
+        {
+            std::printf("%-6s not available\n", level_name(level));
+            continue;
+        }
+
+        if (mode == "bench")
+        {
+            bench_level(renderer, *kernels);
+            continue;
+        }
+
+        bool level_ok = test_spans(scalar, *kernels) && test_framebuffer(renderer, scalar, *kernels);
+        std::printf("%-6s %s\n", level_name(level), level_ok ? "ok" : "FAILED");
+        ok &= level_ok;
+    }
+
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    return ok ? 0 : 1;
+}